@@ -63,6 +63,7 @@
 #endif
 #ifdef __linux__
 #include <dirent.h>
+#include <sys/eventfd.h>
 #ifndef __ANDROID__
 #include "linux/serial.h"
 #endif
@@ -112,6 +113,23 @@ struct sp_port {
 	BOOL wait_running;
 #else
 	int fd;
+	/* Driver settings to restore after sp_set_low_latency(), or -1. */
+	int low_latency;
+	int saved_serial_flags;
+	int saved_latency_timer;
+#endif
+};
+
+struct sp_hotplug {
+#ifndef _WIN32
+	int fd;
+	int netlink;
+	/* inotify may return several events per read */
+	char buf[4096];
+	int len;
+	int pos;
+#else
+	int unused;
 #endif
 };
 
@@ -147,6 +165,23 @@ typedef HANDLE event_handle;
 typedef int event_handle;
 #endif
 
+/*
+ * An event set as the library allocates it. The public part lists the
+ * caller's handles only; the wait array holds the wakeup handle first and
+ * then the same handles, built as they are added so that sp_wait() does
+ * not allocate.
+ */
+struct sp_event_set_private {
+	struct sp_event_set set;
+#ifdef _WIN32
+	HANDLE *wait_array;
+#else
+	struct pollfd *wait_array;
+	int wakeup_fd;	/* written by sp_event_set_wakeup() */
+#endif
+	event_handle wakeup;	/* first in the wait array */
+};
+
 /* Standard baud rates. */
 #ifdef _WIN32
 #define BAUD_TYPE DWORD
@@ -231,5 +266,11 @@ SP_PRIV struct sp_port **list_append(struct sp_port **list, const char *portname
 /* OS-specific Helper functions. */
 SP_PRIV enum sp_return get_port_details(struct sp_port *port);
 SP_PRIV enum sp_return list_ports(struct sp_port ***list);
+#ifdef __linux__
+SP_PRIV enum sp_return set_low_latency(struct sp_port *port, int enable);
+SP_PRIV enum sp_return hotplug_open(struct sp_hotplug *monitor);
+SP_PRIV enum sp_return hotplug_read(struct sp_hotplug *monitor,
+	enum sp_hotplug_event *event, char *portname, size_t portname_len);
+#endif
 
 #endif
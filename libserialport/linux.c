@@ -21,6 +21,9 @@
 #include <config.h>
 #include "libserialport.h"
 #include "libserialport_internal.h"
+#include <sys/socket.h>
+#include <sys/inotify.h>
+#include <linux/netlink.h>
 
 SP_PRIV enum sp_return get_port_details(struct sp_port *port)
 {
@@ -245,3 +248,217 @@ SP_PRIV enum sp_return list_ports(struct sp_port ***list)
 
 	return ret;
 }
+
+/* sysfs name of the tty behind a port, following /dev/serial/by-* links */
+static const char *tty_name(const char *name, char *buf, size_t len)
+{
+	const char *base;
+
+#ifdef HAVE_REALPATH
+	char *resolved;
+	if ((resolved = realpath(name, NULL))) {
+		snprintf(buf, len, "%s", resolved);
+		free(resolved);
+		name = buf;
+	}
+#endif
+	base = strrchr(name, '/');
+	return base ? base + 1 : name;
+}
+
+SP_PRIV enum sp_return set_low_latency(struct sp_port *port, int enable)
+{
+	char real[PATH_MAX], file_name[PATH_MAX];
+	const char *dev = tty_name(port->name, real, sizeof(real));
+	int value, timer, changed = 0;
+	FILE *file;
+#if defined(HAVE_STRUCT_SERIAL_STRUCT) && defined(ASYNC_LOW_LATENCY)
+	struct serial_struct serial_info;
+#endif
+
+	/* Only FTDI adapters have this; writing it usually needs root or udev rules. */
+	value = snprintf(file_name, sizeof(file_name),
+		"/sys/class/tty/%s/device/latency_timer", dev);
+	if (!(timer = value > 0 && (size_t)value < sizeof(file_name)))
+		DEBUG_FMT("Device name %s too long, latency timer left alone", dev);
+
+	if (enable) {
+#if defined(HAVE_STRUCT_SERIAL_STRUCT) && defined(ASYNC_LOW_LATENCY)
+		if (ioctl(port->fd, TIOCGSERIAL, &serial_info) == 0) {
+			value = serial_info.flags;
+			serial_info.flags |= ASYNC_LOW_LATENCY;
+			if (ioctl(port->fd, TIOCSSERIAL, &serial_info) == 0) {
+				port->saved_serial_flags = value;
+				changed = 1;
+			} else {
+				DEBUG("TIOCSSERIAL failed, driver flags unchanged");
+			}
+		}
+#endif
+		if (timer && (file = fopen(file_name, "r"))) {
+			if (fscanf(file, "%d", &value) != 1)
+				value = -1;
+			fclose(file);
+			if (value == 1) {
+				changed = 1;
+			} else if (value > 1 && (file = fopen(file_name, "w"))) {
+				if (fprintf(file, "1") > 0 && fclose(file) == 0) {
+					port->saved_latency_timer = value;
+					changed = 1;
+				} else {
+					DEBUG("Latency timer write failed");
+				}
+			} else {
+				DEBUG_FMT("Cannot write %s", file_name);
+			}
+		}
+		if (!changed)
+			RETURN_ERROR(SP_ERR_SUPP, "Low latency mode not supported");
+	} else {
+#if defined(HAVE_STRUCT_SERIAL_STRUCT) && defined(ASYNC_LOW_LATENCY)
+		if (port->saved_serial_flags >= 0
+				&& ioctl(port->fd, TIOCGSERIAL, &serial_info) == 0) {
+			serial_info.flags &= ~ASYNC_LOW_LATENCY;
+			serial_info.flags |= port->saved_serial_flags & ASYNC_LOW_LATENCY;
+			if (ioctl(port->fd, TIOCSSERIAL, &serial_info) != 0)
+				DEBUG("TIOCSSERIAL failed, driver flags not restored");
+		}
+#endif
+		if (timer && port->saved_latency_timer >= 0) {
+			if ((file = fopen(file_name, "w"))) {
+				value = fprintf(file, "%d", port->saved_latency_timer);
+				if (fclose(file) != 0 || value <= 0)
+					DEBUG("Latency timer write failed, not restored");
+			} else {
+				DEBUG_FMT("Cannot write %s", file_name);
+			}
+		}
+		port->saved_serial_flags = -1;
+		port->saved_latency_timer = -1;
+	}
+
+	RETURN_OK();
+}
+
+SP_PRIV enum sp_return hotplug_open(struct sp_hotplug *monitor)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	/* Kernel uevents (multicast group 1) carry the tty subsystem events. */
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		NETLINK_KOBJECT_UEVENT);
+	if (fd >= 0) {
+		memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = 1;
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+			DEBUG("Watching kernel uevents");
+			monitor->fd = fd;
+			monitor->netlink = 1;
+			RETURN_OK();
+		}
+		close(fd);
+	}
+
+	DEBUG("Kernel uevents unavailable, watching /dev instead");
+	if ((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+		RETURN_FAIL("inotify_init1() failed");
+	if (inotify_add_watch(fd, "/dev", IN_CREATE | IN_DELETE) < 0) {
+		close(fd);
+		RETURN_FAIL("inotify_add_watch() failed");
+	}
+	monitor->fd = fd;
+	monitor->netlink = 0;
+
+	RETURN_OK();
+}
+
+static enum sp_return hotplug_read_uevent(struct sp_hotplug *monitor,
+	enum sp_hotplug_event *event, char *portname, size_t portname_len)
+{
+	char buf[8192];
+	const char *action, *subsystem, *devname, *ptr;
+	ssize_t len;
+
+	while (1) {
+		len = recv(monitor->fd, buf, sizeof(buf) - 1, 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				RETURN_OK();
+			if (errno == EINTR)
+				continue;
+			RETURN_FAIL("recv() failed");
+		}
+		buf[len] = 0;
+
+		/* "action@devpath" followed by NUL separated KEY=value pairs. */
+		action = subsystem = devname = NULL;
+		for (ptr = buf; ptr < buf + len; ptr += strlen(ptr) + 1) {
+			if (!strncmp(ptr, "ACTION=", 7))
+				action = ptr + 7;
+			else if (!strncmp(ptr, "SUBSYSTEM=", 10))
+				subsystem = ptr + 10;
+			else if (!strncmp(ptr, "DEVNAME=", 8))
+				devname = ptr + 8;
+		}
+		if (!action || !subsystem || !devname || strcmp(subsystem, "tty"))
+			continue;
+
+		if (!strcmp(action, "add"))
+			*event = SP_HOTPLUG_ADDED;
+		else if (!strcmp(action, "remove"))
+			*event = SP_HOTPLUG_REMOVED;
+		else
+			continue;
+
+		if (strncmp(devname, "/dev/", 5))
+			snprintf(portname, portname_len, "/dev/%s", devname);
+		else
+			snprintf(portname, portname_len, "%s", devname);
+		DEBUG_FMT("Hotplug event %d for %s", *event, portname);
+		RETURN_OK();
+	}
+}
+
+static enum sp_return hotplug_read_inotify(struct sp_hotplug *monitor,
+	enum sp_hotplug_event *event, char *portname, size_t portname_len)
+{
+	struct inotify_event *ev;
+	ssize_t len;
+
+	while (1) {
+		if (monitor->pos >= monitor->len) {
+			len = read(monitor->fd, monitor->buf, sizeof(monitor->buf));
+			if (len < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					RETURN_OK();
+				if (errno == EINTR)
+					continue;
+				RETURN_FAIL("read() failed");
+			}
+			monitor->len = len;
+			monitor->pos = 0;
+		}
+
+		ev = (struct inotify_event *)(monitor->buf + monitor->pos);
+		monitor->pos += sizeof(struct inotify_event) + ev->len;
+
+		if (!ev->len || strncmp(ev->name, "tty", 3))
+			continue;
+
+		*event = (ev->mask & IN_CREATE) ? SP_HOTPLUG_ADDED : SP_HOTPLUG_REMOVED;
+		snprintf(portname, portname_len, "/dev/%s", ev->name);
+		DEBUG_FMT("Hotplug event %d for %s", *event, portname);
+		RETURN_OK();
+	}
+}
+
+SP_PRIV enum sp_return hotplug_read(struct sp_hotplug *monitor,
+	enum sp_hotplug_event *event, char *portname, size_t portname_len)
+{
+	if (monitor->netlink)
+		return hotplug_read_uevent(monitor, event, portname, portname_len);
+	else
+		return hotplug_read_inotify(monitor, event, portname, portname_len);
+}
@@ -548,6 +548,10 @@ SP_API enum sp_return sp_open(struct sp_port *port, enum sp_mode flags)
 
 	if ((port->fd = open(port->name, flags_local)) < 0)
 		RETURN_FAIL("open() failed");
+
+	port->low_latency = 0;
+	port->saved_serial_flags = -1;
+	port->saved_latency_timer = -1;
 #endif
 
 	ret = get_config(port, &data, &config);
@@ -643,6 +647,12 @@ SP_API enum sp_return sp_close(struct sp_port *port)
 	CLOSE_OVERLAPPED(wait_ovl);
 
 #else
+#ifdef __linux__
+	/* Put back the driver settings changed by sp_set_low_latency(). */
+	if (port->low_latency && set_low_latency(port, 0) != SP_OK)
+		DEBUG("Failed to restore latency settings");
+	port->low_latency = 0;
+#endif
 	/* Returns 0 upon success, -1 upon failure. */
 	if (close(port->fd) == -1)
 		RETURN_FAIL("close() failed");
@@ -652,6 +662,26 @@ SP_API enum sp_return sp_close(struct sp_port *port)
 	RETURN_OK();
 }
 
+SP_API enum sp_return sp_set_low_latency(struct sp_port *port, int enable)
+{
+	TRACE("%p, %d", port, enable);
+
+	CHECK_OPEN_PORT();
+
+#ifdef __linux__
+	enable = enable ? 1 : 0;
+	if (enable == port->low_latency)
+		RETURN_OK();
+
+	TRY(set_low_latency(port, enable));
+	port->low_latency = enable;
+
+	RETURN_OK();
+#else
+	RETURN_ERROR(SP_ERR_SUPP, "Low latency mode not supported");
+#endif
+}
+
 SP_API enum sp_return sp_flush(struct sp_port *port, enum sp_buffer buffers)
 {
 	TRACE("%p, 0x%x", port, buffers);
@@ -1337,30 +1367,10 @@ SP_API enum sp_return sp_output_waiting(struct sp_port *port)
 #endif
 }
 
-SP_API enum sp_return sp_new_event_set(struct sp_event_set **result_ptr)
-{
-	struct sp_event_set *result;
-
-	TRACE("%p", result_ptr);
-
-	if (!result_ptr)
-		RETURN_ERROR(SP_ERR_ARG, "Null result");
-
-	*result_ptr = NULL;
-
-	if (!(result = malloc(sizeof(struct sp_event_set))))
-		RETURN_ERROR(SP_ERR_MEM, "sp_event_set malloc() failed");
-
-	memset(result, 0, sizeof(struct sp_event_set));
-
-	*result_ptr = result;
-
-	RETURN_OK();
-}
-
 static enum sp_return add_handle(struct sp_event_set *event_set,
 		event_handle handle, enum sp_event mask)
 {
+	struct sp_event_set_private *priv = (struct sp_event_set_private *) event_set;
 	void *new_handles;
 	enum sp_event *new_masks;
 
@@ -1378,6 +1388,38 @@ static enum sp_return add_handle(struct sp_event_set *event_set,
 
 	event_set->masks = new_masks;
 
+	/* The wait array also holds the wakeup handle, ahead of these. */
+#ifdef _WIN32
+	HANDLE *new_wait;
+
+	if (!(new_wait = realloc(priv->wait_array,
+			sizeof(HANDLE) * (event_set->count + 2))))
+		RETURN_ERROR(SP_ERR_MEM, "Wait array realloc() failed");
+
+	priv->wait_array = new_wait;
+	new_wait[event_set->count + 1] = handle;
+#else
+	struct pollfd *pollfd;
+
+	if (!(pollfd = realloc(priv->wait_array,
+			sizeof(struct pollfd) * (event_set->count + 2))))
+		RETURN_ERROR(SP_ERR_MEM, "Wait array realloc() failed");
+
+	priv->wait_array = pollfd;
+
+	/* Built once here so that sp_wait() does not need to allocate. */
+	pollfd += event_set->count + 1;
+	pollfd->fd = handle;
+	pollfd->events = 0;
+	pollfd->revents = 0;
+	if (mask & SP_EVENT_RX_READY)
+		pollfd->events |= POLLIN;
+	if (mask & SP_EVENT_TX_READY)
+		pollfd->events |= POLLOUT;
+	if (mask & SP_EVENT_ERROR)
+		pollfd->events |= POLLERR;
+#endif
+
 	((event_handle *) event_set->handles)[event_set->count] = handle;
 	event_set->masks[event_set->count] = mask;
 
@@ -1386,6 +1428,69 @@ static enum sp_return add_handle(struct sp_event_set *event_set,
 	RETURN_OK();
 }
 
+SP_API enum sp_return sp_new_event_set(struct sp_event_set **result_ptr)
+{
+	struct sp_event_set_private *result;
+	event_handle wakeup;
+
+	TRACE("%p", result_ptr);
+
+	if (!result_ptr)
+		RETURN_ERROR(SP_ERR_ARG, "Null result");
+
+	*result_ptr = NULL;
+
+	if (!(result = malloc(sizeof(struct sp_event_set_private))))
+		RETURN_ERROR(SP_ERR_MEM, "sp_event_set malloc() failed");
+
+	memset(result, 0, sizeof(struct sp_event_set_private));
+
+	if (!(result->wait_array = malloc(sizeof(*result->wait_array)))) {
+		free(result);
+		RETURN_ERROR(SP_ERR_MEM, "Wait array malloc() failed");
+	}
+
+	/* The wakeup handle is always the first one waited on. */
+#ifdef _WIN32
+	if (!(wakeup = CreateEvent(NULL, FALSE, FALSE, NULL))) {
+		free(result->wait_array);
+		free(result);
+		RETURN_FAIL("CreateEvent() failed");
+	}
+	result->wait_array[0] = wakeup;
+#else
+#ifdef __linux__
+	if ((wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		free(result->wait_array);
+		free(result);
+		RETURN_FAIL("eventfd() failed");
+	}
+	result->wakeup_fd = wakeup;
+#else
+	int fds[2], i;
+	if (pipe(fds) < 0) {
+		free(result->wait_array);
+		free(result);
+		RETURN_FAIL("pipe() failed");
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	wakeup = fds[0];
+	result->wakeup_fd = fds[1];
+#endif
+	result->wait_array[0].fd = wakeup;
+	result->wait_array[0].events = POLLIN;
+	result->wait_array[0].revents = 0;
+#endif
+	result->wakeup = wakeup;
+
+	*result_ptr = &result->set;
+
+	RETURN_OK();
+}
+
 SP_API enum sp_return sp_add_port_events(struct sp_event_set *event_set,
 	const struct sp_port *port, enum sp_event mask)
 {
@@ -1418,6 +1523,8 @@ SP_API enum sp_return sp_add_port_events(struct sp_event_set *event_set,
 
 SP_API void sp_free_event_set(struct sp_event_set *event_set)
 {
+	struct sp_event_set_private *priv = (struct sp_event_set_private *) event_set;
+
 	TRACE("%p", event_set);
 
 	if (!event_set) {
@@ -1427,12 +1534,21 @@ SP_API void sp_free_event_set(struct sp_event_set *event_set)
 
 	DEBUG("Freeing event set");
 
+#ifdef _WIN32
+	CloseHandle(priv->wakeup);
+#else
+	if (priv->wakeup_fd != priv->wakeup)
+		close(priv->wakeup_fd);
+	close(priv->wakeup);
+#endif
+
 	if (event_set->handles)
 		free(event_set->handles);
 	if (event_set->masks)
 		free(event_set->masks);
+	free(priv->wait_array);
 
-	free(event_set);
+	free(priv);
 
 	RETURN();
 }
@@ -1440,13 +1556,15 @@ SP_API void sp_free_event_set(struct sp_event_set *event_set)
 SP_API enum sp_return sp_wait(struct sp_event_set *event_set,
                               unsigned int timeout_ms)
 {
+	struct sp_event_set_private *priv = (struct sp_event_set_private *) event_set;
+
 	TRACE("%p, %d", event_set, timeout_ms);
 
 	if (!event_set)
 		RETURN_ERROR(SP_ERR_ARG, "Null event set");
 
 #ifdef _WIN32
-	if (WaitForMultipleObjects(event_set->count, event_set->handles, FALSE,
+	if (WaitForMultipleObjects(event_set->count + 1, priv->wait_array, FALSE,
 			timeout_ms ? timeout_ms : INFINITE) == WAIT_FAILED)
 		RETURN_FAIL("WaitForMultipleObjects() failed");
 
@@ -1457,23 +1575,8 @@ SP_API enum sp_return sp_wait(struct sp_event_set *event_set,
 		(INT_MAX / 1000), (INT_MAX % 1000) * 1000};
 	int started = 0, timeout_overflow = 0;
 	int result, timeout_remaining_ms;
-	struct pollfd *pollfds;
-	unsigned int i;
-
-	if (!(pollfds = malloc(sizeof(struct pollfd) * event_set->count)))
-		RETURN_ERROR(SP_ERR_MEM, "pollfds malloc() failed");
-
-	for (i = 0; i < event_set->count; i++) {
-		pollfds[i].fd = ((int *) event_set->handles)[i];
-		pollfds[i].events = 0;
-		pollfds[i].revents = 0;
-		if (event_set->masks[i] & SP_EVENT_RX_READY)
-			pollfds[i].events |= POLLIN;
-		if (event_set->masks[i] & SP_EVENT_TX_READY)
-			pollfds[i].events |= POLLOUT;
-		if (event_set->masks[i] & SP_EVENT_ERROR)
-			pollfds[i].events |= POLLERR;
-	}
+	struct pollfd *pollfds = priv->wait_array;
+	char drain[64];
 
 	if (timeout_ms) {
 		/* Get time at start of operation. */
@@ -1509,7 +1612,7 @@ SP_API enum sp_return sp_wait(struct sp_event_set *event_set,
 			timeout_remaining_ms = delta.tv_sec * 1000 + delta.tv_usec / 1000;
 		}
 
-		result = poll(pollfds, event_set->count, timeout_remaining_ms);
+		result = poll(pollfds, event_set->count + 1, timeout_remaining_ms);
 		started = 1;
 
 		if (result < 0) {
@@ -1517,7 +1620,6 @@ SP_API enum sp_return sp_wait(struct sp_event_set *event_set,
 				DEBUG("poll() call was interrupted, repeating");
 				continue;
 			} else {
-				free(pollfds);
 				RETURN_FAIL("poll() failed");
 			}
 		} else if (result == 0) {
@@ -1530,11 +1632,131 @@ SP_API enum sp_return sp_wait(struct sp_event_set *event_set,
 		}
 	}
 
-	free(pollfds);
+	/* Consume any wakeups so that the next wait blocks again. */
+	if (pollfds[0].revents & POLLIN)
+		while (read(pollfds[0].fd, drain, sizeof(drain)) > 0)
+			;
+
+	RETURN_OK();
+#endif
+}
+
+SP_API enum sp_return sp_event_set_wakeup(struct sp_event_set *event_set)
+{
+	struct sp_event_set_private *priv = (struct sp_event_set_private *) event_set;
+
+	TRACE("%p", event_set);
+
+	if (!event_set)
+		RETURN_ERROR(SP_ERR_ARG, "Null event set");
+
+#ifdef _WIN32
+	if (!SetEvent(priv->wakeup))
+		RETURN_FAIL("SetEvent() failed");
+#else
+	/* An eventfd needs an 8-byte counter; a pipe takes any bytes. */
+	unsigned long long one = 1;
+	if (write(priv->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		RETURN_FAIL("Wakeup write() failed");
+#endif
+
+	RETURN_OK();
+}
+
+SP_API enum sp_return sp_new_hotplug_monitor(struct sp_hotplug **monitor_ptr)
+{
+	TRACE("%p", monitor_ptr);
+
+	if (!monitor_ptr)
+		RETURN_ERROR(SP_ERR_ARG, "Null result");
+
+	*monitor_ptr = NULL;
+
+#ifdef __linux__
+	struct sp_hotplug *monitor;
+	enum sp_return ret;
+
+	if (!(monitor = malloc(sizeof(struct sp_hotplug))))
+		RETURN_ERROR(SP_ERR_MEM, "sp_hotplug malloc() failed");
+
+	memset(monitor, 0, sizeof(struct sp_hotplug));
+
+	if ((ret = hotplug_open(monitor)) != SP_OK) {
+		free(monitor);
+		RETURN_CODEVAL(ret);
+	}
+
+	*monitor_ptr = monitor;
+
 	RETURN_OK();
+#else
+	RETURN_ERROR(SP_ERR_SUPP, "Hotplug monitoring not supported");
+#endif
+}
+
+SP_API enum sp_return sp_add_hotplug_events(struct sp_event_set *event_set,
+	const struct sp_hotplug *monitor)
+{
+	TRACE("%p, %p", event_set, monitor);
+
+	if (!event_set)
+		RETURN_ERROR(SP_ERR_ARG, "Null event set");
+
+	if (!monitor)
+		RETURN_ERROR(SP_ERR_ARG, "Null monitor");
+
+#ifdef __linux__
+	TRY(add_handle(event_set, monitor->fd, SP_EVENT_RX_READY));
+
+	RETURN_OK();
+#else
+	RETURN_ERROR(SP_ERR_SUPP, "Hotplug monitoring not supported");
 #endif
 }
 
+SP_API enum sp_return sp_read_hotplug_event(struct sp_hotplug *monitor,
+	enum sp_hotplug_event *event_ptr, char *portname, size_t portname_len)
+{
+	TRACE("%p, %p, %p, %d", monitor, event_ptr, portname, (int)portname_len);
+
+	if (!monitor)
+		RETURN_ERROR(SP_ERR_ARG, "Null monitor");
+
+	if (!event_ptr)
+		RETURN_ERROR(SP_ERR_ARG, "Null result");
+
+	if (!portname || !portname_len)
+		RETURN_ERROR(SP_ERR_ARG, "Null port name buffer");
+
+	*event_ptr = SP_HOTPLUG_NONE;
+	portname[0] = '\0';
+
+#ifdef __linux__
+	RETURN_CODEVAL(hotplug_read(monitor, event_ptr, portname, portname_len));
+#else
+	RETURN_ERROR(SP_ERR_SUPP, "Hotplug monitoring not supported");
+#endif
+}
+
+SP_API void sp_free_hotplug_monitor(struct sp_hotplug *monitor)
+{
+	TRACE("%p", monitor);
+
+	if (!monitor) {
+		DEBUG("Null monitor");
+		RETURN();
+	}
+
+	DEBUG("Freeing hotplug monitor");
+
+#ifndef _WIN32
+	close(monitor->fd);
+#endif
+	free(monitor);
+
+	RETURN();
+}
+
 #ifdef USE_TERMIOS_SPEED
 static enum sp_return get_baudrate(int fd, int *baudrate)
 {
@@ -0,0 +1,277 @@
+/*
+ * visca_calibrate - measures a camera's pan, tilt and zoom speeds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+Usage: visca_calibrate [-c <camera>] [-o <profile>] [-d <pan deg> <tilt deg>]
+                       [-t <ms>] <serial port device>
+
+Finds the travel limits of each axis, then drives it at every speed index
+and fits a line through timestamped position inquiries, skipping the
+acceleration at the start. Each run heads for the farther limit and stops
+short of it, so the head sweeps back and forth without repositioning.
+
+The profile (default visca-<vendor>-<model>.profile) is a text file that
+[visca] loads with [profile <file>(:
+
+# comment
+model <vendor> <model>
+units_per_degree pan|tilt <units>
+speed_table pan|tilt|zoom <units per second for each speed index>
+fov_table <horizontal field of view in degrees, wide to tele>
+
+The field of view cannot be measured over VISCA: add the fov_table line
+by hand from the camera's data sheet (9 values at evenly spaced zoom
+positions) if [drive_fov( should use more than the EVI-D70 default.
+
+Units per degree come from the measured travel and the mechanical range
+given with -d (default 340 120, the EVI-D70's pan and tilt range).
+Keep clear of the camera while it runs: every axis goes to its limits.
+*/
+
+#include "../visca/libvisca.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAL_AXIS_PAN      0
+#define CAL_AXIS_TILT     1
+#define CAL_AXIS_ZOOM     2
+#define CAL_AXES          3
+
+#define CAL_SETTLE_MS     200    /* acceleration: samples before this are left out */
+#define CAL_RUN_MS        2500   /* longest run per speed index */
+#define CAL_SAMPLE_MS     20     /* pause between position inquiries */
+#define CAL_LIMIT_MS      20000  /* longest run to a limit */
+#define CAL_MARGIN        0.1    /* of the travel kept clear of the limits */
+#define CAL_MIN_TRAVEL    100    /* units; less means the axis does not move */
+#define CAL_SAMPLES       512
+
+static const char *axis_names[CAL_AXES] = { "pan", "tilt", "zoom" };
+static const int axis_first[CAL_AXES] = { 1, 1, 0 };
+static const int axis_last[CAL_AXES] = { 24, 20, 7 };
+
+static VISCAInterface_t iface;
+static VISCACamera_t camera;
+
+/*print usage message and exit*/
+static void print_usage() {
+  fprintf(stderr, "Usage: visca_calibrate [-c <camera>] [-o <profile>] [-d <pan deg> <tilt deg>]\n"
+          "                       [-t <ms>] <serial port device>\n");
+  exit(1);
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* start an axis moving: dir +1 is right, up or tele, 0 stops it */
+static uint32_t drive(int axis, int dir, int speed) {
+  if (axis == CAL_AXIS_ZOOM)
+    return dir > 0 ? VISCA_set_zoom_tele_speed(&iface, &camera, speed)
+      : dir < 0 ? VISCA_set_zoom_wide_speed(&iface, &camera, speed)
+      : VISCA_set_zoom_stop(&iface, &camera);
+  if (dir == 0)
+    return VISCA_set_pantilt_stop(&iface, &camera, 1, 1);
+  if (axis == CAL_AXIS_PAN)
+    return dir > 0 ? VISCA_set_pantilt_right(&iface, &camera, speed, 1)
+      : VISCA_set_pantilt_left(&iface, &camera, speed, 1);
+  return dir > 0 ? VISCA_set_pantilt_up(&iface, &camera, 1, speed)
+    : VISCA_set_pantilt_down(&iface, &camera, 1, speed);
+}
+
+/* one position reading, stamped halfway through the inquiry */
+static int sample(int axis, double *t, double *value) {
+  int16_t pan, tilt;
+  uint16_t zoom;
+  double start = now_ms();
+  uint32_t err;
+
+  if (axis == CAL_AXIS_ZOOM)
+    err = VISCA_get_zoom_value(&iface, &camera, &zoom);
+  else
+    err = VISCA_get_pantilt_position(&iface, &camera, &pan, &tilt);
+  if (err != VISCA_SUCCESS)
+    return 0;
+  *t = (start + now_ms()) / 2;
+  *value = axis == CAL_AXIS_PAN ? pan : axis == CAL_AXIS_TILT ? tilt : zoom;
+  return 1;
+}
+
+/* drive at full speed until the position stops changing */
+static int find_limit(int axis, int dir, double *limit) {
+  double start = now_ms(), t, value, last = 0;
+  int n = 0;
+
+  if (drive(axis, dir, axis_last[axis]) != VISCA_SUCCESS)
+    return 0;
+  while (now_ms() - start < CAL_LIMIT_MS) {
+    usleep(100000);
+    if (!sample(axis, &t, &value))
+      break;
+    if (n++ > 0 && fabs(value - last) < 1) {
+      drive(axis, 0, 0);
+      *limit = value;
+      return 1;
+    }
+    last = value;
+  }
+  drive(axis, 0, 0);
+  return 0;
+}
+
+/* least squares slope of value over time, in units per second */
+static double fit_speed(const double *t, const double *v, int n) {
+  double st = 0, sv = 0, stt = 0, stv = 0, d;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    st += t[i];
+    sv += v[i];
+    stt += t[i] * t[i];
+    stv += t[i] * v[i];
+  }
+  d = n * stt - st * st;
+  return d > 0 ? fabs((n * stv - st * sv) / d) * 1000.0 : 0;
+}
+
+/* one run at a speed index toward the farther limit; 0 when it failed */
+static double measure(int axis, int speed, const double *limits, int run_ms) {
+  double t[CAL_SAMPLES], v[CAL_SAMPLES];
+  double start, now, value, target, margin;
+  int dir, n = 0;
+
+  margin = CAL_MARGIN * fabs(limits[1] - limits[0]);
+  if (!sample(axis, &now, &value))
+    return 0;
+  dir = fabs(limits[1] - value) > fabs(limits[0] - value) ? 1 : -1;
+  target = dir > 0 ? limits[1] : limits[0];
+  if (drive(axis, dir, speed) != VISCA_SUCCESS)
+    return 0;
+  start = now_ms();
+  while (n < CAL_SAMPLES && now_ms() - start < run_ms) {
+    usleep(CAL_SAMPLE_MS * 1000);
+    if (!sample(axis, &now, &value))
+      break;
+    if (fabs(target - value) < margin)
+      break;
+    if (now - start < CAL_SETTLE_MS)
+      continue;
+    t[n] = now - start;
+    v[n++] = value;
+  }
+  drive(axis, 0, 0);
+  usleep(300000);
+  return n >= 3 ? fit_speed(t, v, n) : 0;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  char name[64];
+  double limits[CAL_AXES][2], speeds[CAL_AXES][25], degrees[2] = { 340, 120 };
+  int address = 1, run_ms = CAL_RUN_MS, ncameras, axis, i;
+  int measured[CAL_AXES] = { 0, 0, 0 };
+  FILE *fp;
+
+  for (i = 1; i < argc - 1 && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-c") == 0)
+      address = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-o") == 0)
+      path = argv[++i];
+    else if (strcmp(argv[i], "-t") == 0)
+      run_ms = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i + 2 < argc - 1) {
+      degrees[0] = atof(argv[++i]);
+      degrees[1] = atof(argv[++i]);
+    } else
+      print_usage();
+  }
+  if (i != argc - 1 || address < 1 || address > 7 || run_ms <= CAL_SETTLE_MS
+      || degrees[0] <= 0 || degrees[1] <= 0)
+    print_usage();
+
+  if (VISCA_open_serial(&iface, argv[i]) != VISCA_SUCCESS) {
+    fprintf(stderr, "visca_calibrate: unable to open serial device %s\n", argv[i]);
+    exit(1);
+  }
+  iface.broadcast = 0;
+  if (VISCA_set_address(&iface, &ncameras) != VISCA_SUCCESS || address > ncameras) {
+    fprintf(stderr, "visca_calibrate: no camera %i on %s\n", address, argv[i]);
+    exit(1);
+  }
+  camera.address = address;
+  VISCA_clear(&iface, &camera);
+  if (VISCA_get_camera_info(&iface, &camera) != VISCA_SUCCESS) {
+    fprintf(stderr, "visca_calibrate: camera %i does not answer\n", address);
+    exit(1);
+  }
+  fprintf(stderr, "visca_calibrate: vendor 0x%04x model 0x%04x rom 0x%04x\n",
+          camera.vendor, camera.model, camera.rom_version);
+
+  for (axis = 0; axis < CAL_AXES; axis++) {
+    if (!find_limit(axis, -1, &limits[axis][0]) || !find_limit(axis, 1, &limits[axis][1])
+        || fabs(limits[axis][1] - limits[axis][0]) < CAL_MIN_TRAVEL) {
+      fprintf(stderr, "visca_calibrate: %s does not move, skipped\n", axis_names[axis]);
+      continue;
+    }
+    fprintf(stderr, "visca_calibrate: %s travel %g to %g\n", axis_names[axis],
+            limits[axis][0], limits[axis][1]);
+    for (i = axis_first[axis]; i <= axis_last[axis]; i++) {
+      speeds[axis][i] = measure(axis, i, limits[axis], run_ms);
+      fprintf(stderr, "visca_calibrate: %s speed %i: %.1f units/s\n", axis_names[axis], i,
+              speeds[axis][i]);
+      if (speeds[axis][i] <= 0)
+        break;
+    }
+    measured[axis] = i > axis_last[axis];
+  }
+  VISCA_set_pantilt_home(&iface, &camera);
+  VISCA_close_serial(&iface);
+
+  if (!path) {
+    snprintf(name, sizeof(name), "visca-%04x-%04x.profile", camera.vendor, camera.model);
+    path = name;
+  }
+  if (!(fp = fopen(path, "w"))) {
+    fprintf(stderr, "visca_calibrate: unable to write %s\n", path);
+    exit(1);
+  }
+  fprintf(fp, "# vendor 0x%04x model 0x%04x rom 0x%04x, %i ms runs\n",
+          camera.vendor, camera.model, camera.rom_version, run_ms);
+  fprintf(fp, "model 0x%04x 0x%04x\n", camera.vendor, camera.model);
+  for (axis = 0; axis < CAL_AXES; axis++) {
+    if (!measured[axis])
+      continue;
+    if (axis != CAL_AXIS_ZOOM)
+      fprintf(fp, "units_per_degree %s %.3f\n", axis_names[axis],
+              fabs(limits[axis][1] - limits[axis][0]) / degrees[axis]);
+    fprintf(fp, "speed_table %s", axis_names[axis]);
+    for (i = axis_first[axis]; i <= axis_last[axis]; i++)
+      fprintf(fp, " %.1f", speeds[axis][i]);
+    fprintf(fp, "\n");
+  }
+  fclose(fp);
+  fprintf(stderr, "visca_calibrate: wrote %s\n", path);
+  return 0;
+}
@@ -337,6 +337,31 @@ get_at_obj_pos (returns the center position of the detection frame divided
                 by 48x30 pixels and a status: 0=Setting, 1=Tracking, 2=Lost)
 get_md_obj_pos (returns the center position of the detection frame divided
                 by 48x30 pixels and a status: 1=UnDetect, 2=Detected)
+
+==================================================
+Batch and session mode
+==================================================
+
+visca-cli [-d <serial port device>] -b <file>
+
+opens the interface once and runs one command per line from <file>
+(- or no file: stdin, which makes it usable as a persistent session).
+Empty lines and lines starting with # are skipped. A line may start with
+a camera address, e.g. "2:get_zoom_value"; the default is camera 1.
+Besides the commands above a line may be
+
+raw <byte> ...  (send a message body given in hex, without the header and
+                 terminator, e.g. "raw 01 04 07 02")
+
+Consecutive raw lines are pipelined: they are sent as soon as the camera
+has a free socket and finish in any order. Any other command waits for
+them first.
+
+Every line produces one result line: the line number, the result code
+below and the return values, separated by blanks, e.g. "3 11 512".
+Raw messages report 10 on completion, 14 followed by the reply bytes in
+hex for inquiries, or 46. A line for a camera address beyond the cameras
+found when the interface was opened reports 48.
 */
 
 #include "../visca/libvisca.h"
@@ -345,6 +370,10 @@ get_md_obj_pos (returns the center position of the detection frame divided
 #include <fcntl.h> /* File control definitions */
 #include <errno.h> /* Error number definitions */
 #include <string.h>
+#include <stdint.h>
+#ifdef VISCA_POSIX
+#include <poll.h>
+#endif
 
 #define DEBUG 0
 
@@ -361,10 +390,16 @@ char *ttydev = "COM1:";
 /*Structures needed for the VISCA library*/
 VISCAInterface_t iface;
 VISCACamera_t camera;
+/*cameras answering the address broadcast*/
+int camera_count = 1;
+
+/*Commands are read from this file instead of the command line (-b)*/
+char *batchfile = NULL;
 
 /*print usage message and exit*/
 void print_usage() {
   fprintf(stderr,"Usage: visca-cli [-d <serial port device>] command\n");
+  fprintf(stderr,"       visca-cli [-d <serial port device>] -b [<file>|-]\n");
   fprintf(stderr,"  default serial port device: %s\n",ttydev);      
   fprintf(stderr,"  for available commands see sourcecode...\n");
   exit(1);  
@@ -400,6 +435,12 @@ char *process_commandline(int argc, char **argv) {
       argc -= 2;
     }
   }
+
+  /*Batch mode: the commands come from a file or stdin*/
+  if (strcmp(argv[1], "-b") == 0) {
+    batchfile = (argc > 2) ? argv[2] : "-";
+    return NULL;
+  }
   
   /*concatenate command string*/
 
@@ -441,6 +482,7 @@ void open_interface() {
     VISCA_close_serial(&iface);
     exit(1);
   }
+  camera_count = camera_num;
 
   camera.address=1;
 
@@ -2492,6 +2534,191 @@ int doCommand(char *commandline, int *ret1, int *ret2, int *ret3) {
   return 40;
 }
 
+/* Batch mode: the result line for a command, "<line> <code> [<ret>...]" */
+void print_batch_result(int line, int errorcode, int ret1, int ret2, int ret3) {
+  printf("%i %i", line, errorcode);
+  if (errorcode >= 11 && errorcode <= 13) {
+    printf(" %i", ret1);
+  }
+  if (errorcode >= 12 && errorcode <= 13) {
+    printf(" %i", ret2);
+  }
+  if (errorcode == 13) {
+    printf(" %i", ret3);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+/* Batch mode: the result line for a raw message */
+void print_raw_result(int line, uint32_t status, const unsigned char *reply,
+                      uint32_t length) {
+  uint32_t i;
+  if (status != VISCA_SUCCESS) {
+    printf("%i 46\n", line);
+  } else if (length > 3) {
+    /*inquiry data rather than a bare completion*/
+    printf("%i 14", line);
+    for (i = 0; i < length; i++) {
+      printf(" %02x", reply[i]);
+    }
+    printf("\n");
+  } else {
+    printf("%i 10\n", line);
+  }
+  fflush(stdout);
+}
+
+/* Batch mode: turn "01 04 07 02" into a message body; 0 if it is not hex */
+int parse_raw(char *args, VISCAPacket_t *packet) {
+  char *byte, *end;
+  long value;
+
+  _VISCA_init_packet(packet);
+  for (byte = strtok(args, " "); byte != NULL; byte = strtok(NULL, " ")) {
+    value = strtol(byte, &end, 16);
+    if (*end != '\0' || value < 0 || value > 0xfe
+        || packet->length >= sizeof(packet->bytes) - 1) {
+      return 0;
+    }
+    _VISCA_append_byte(packet, (unsigned char)value);
+  }
+  return packet->length > 1;
+}
+
+#ifdef VISCA_POSIX
+/* Raw messages go through a reactor so that several can be in flight;
+ * the interface is handed to it for a run of raw lines and taken back
+ * before the next ordinary command.
+ */
+VISCAReactor_t *reactor = NULL;
+int reactor_port = -1;
+int raw_pending = 0;
+
+void raw_done(void *user, int port, uint32_t camera_address, uint32_t status,
+              const unsigned char *reply, uint32_t length) {
+  (void)port;
+  (void)camera_address;
+  print_raw_result((int)(intptr_t)user, status, reply, length);
+  raw_pending--;
+}
+
+/* run the reactor until the next line can be read, so replies to raw
+ * messages are printed while the session waits for input */
+void raw_wait_input(FILE *in) {
+  struct pollfd pfd;
+
+  pfd.fd = fileno(in);
+  pfd.events = POLLIN;
+  while (raw_pending > 0) {
+    if (poll(&pfd, 1, 0) != 0) {
+      return;
+    }
+    VISCA_reactor_run(reactor, 10000);
+  }
+}
+
+/* wait for every raw message in flight, then give the interface back */
+void raw_drain() {
+  while (raw_pending > 0) {
+    VISCA_reactor_run(reactor, 0);
+  }
+  if (reactor_port >= 0) {
+    VISCA_reactor_remove(reactor, reactor_port);
+    reactor_port = -1;
+  }
+}
+
+void raw_submit(int line, VISCAPacket_t *packet) {
+  if (reactor == NULL && VISCA_reactor_new(&reactor) != VISCA_SUCCESS) {
+    print_raw_result(line, VISCA_FAILURE, NULL, 0);
+    return;
+  }
+  if (reactor_port < 0
+      && VISCA_reactor_add(reactor, &iface, &reactor_port) != VISCA_SUCCESS) {
+    print_raw_result(line, VISCA_FAILURE, NULL, 0);
+    return;
+  }
+  /*a full queue makes room as replies come in*/
+  while (VISCA_reactor_submit(reactor, reactor_port, &camera, packet,
+                              raw_done, (void *)(intptr_t)line) != VISCA_SUCCESS) {
+    if (raw_pending == 0) {
+      print_raw_result(line, VISCA_FAILURE, NULL, 0);
+      return;
+    }
+    VISCA_reactor_run(reactor, 0);
+  }
+  raw_pending++;
+  /*start sending right away*/
+  VISCA_reactor_run(reactor, 1);
+}
+#else
+void raw_wait_input(FILE *in) {
+  (void)in;
+}
+
+void raw_drain() {
+}
+
+void raw_submit(int line, VISCAPacket_t *packet) {
+  uint32_t status;
+  status = _VISCA_send_packet_with_reply(&iface, &camera, packet);
+  if (status == VISCA_SUCCESS && iface.type == VISCA_RESPONSE_ERROR) {
+    status = VISCA_FAILURE;
+  }
+  print_raw_result(line, status, iface.ibuf, iface.bytes);
+}
+#endif
+
+/* Batch mode: run every line of the file over the open interface */
+void run_batch(FILE *in) {
+  char buffer[1024];
+  char *commandline;
+  VISCAPacket_t packet;
+  int line = 0, address, errorcode, ret1, ret2, ret3;
+
+  for (;;) {
+    raw_wait_input(in);
+    if (fgets(buffer, sizeof(buffer), in) == NULL) {
+      break;
+    }
+    line++;
+    buffer[strcspn(buffer, "\r\n")] = '\0';
+    commandline = buffer + strspn(buffer, " \t");
+    if (*commandline == '\0' || *commandline == '#') {
+      continue;
+    }
+
+    /*optional camera address prefix*/
+    camera.address = 1;
+    if (commandline[0] >= '1' && commandline[0] <= '7' && commandline[1] == ':') {
+      address = commandline[0] - '0';
+      commandline += 2;
+      camera.address = address;
+    }
+    if (camera.address > camera_count) {
+      print_batch_result(line, 48, 0, 0, 0);
+      continue;
+    }
+
+    if (strncmp(commandline, "raw ", 4) == 0) {
+      if (!parse_raw(commandline + 4, &packet)) {
+        print_batch_result(line, 41, 0, 0, 0);
+      } else {
+        raw_submit(line, &packet);
+      }
+      continue;
+    }
+
+    raw_drain();
+    ret1 = ret2 = ret3 = 0;
+    errorcode = doCommand(commandline, &ret1, &ret2, &ret3);
+    print_batch_result(line, errorcode, ret1, ret2, ret3);
+  }
+  raw_drain();
+  camera.address = 1;
+}
+
 int main(int argc, char **argv) {
   char *commandline;
   int errorcode, ret1, ret2, ret3;
@@ -2500,6 +2727,26 @@ int main(int argc, char **argv) {
   
   open_interface();
 
+  if (batchfile != NULL) {
+    FILE *in = stdin;
+    if (strcmp(batchfile, "-") != 0 && (in = fopen(batchfile, "r")) == NULL) {
+      fprintf(stderr, "visca-cli: unable to open %s\n", batchfile);
+      close_interface();
+      exit(1);
+    }
+    run_batch(in);
+    if (in != stdin) {
+      fclose(in);
+    }
+#ifdef VISCA_POSIX
+    if (reactor != NULL) {
+      VISCA_reactor_free(reactor);
+    }
+#endif
+    close_interface();
+    exit(0);
+  }
+
   errorcode = doCommand(commandline, &ret1, &ret2, &ret3);
   switch(errorcode) {
     case 10:
@@ -0,0 +1,631 @@
+/*
+ * viscad - shares VISCA(tm) serial ports between local processes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+Usage: viscad [-s <socket path>] <serial port device> [<device> ...]
+
+The daemon opens every device, runs the address/clear handshake once and
+serves all cameras from one reactor thread. A device whose I/O fails is
+reopened every few seconds until the handshake succeeds again. Clients
+connect to a Unix domain socket (default $XDG_RUNTIME_DIR/viscad.sock,
+accessible to the owner only) and exchange lines; every request starts
+with a tag of the client's choosing that is repeated in the answer.
+
+Requests:
+=========
+<tag> ports                          (one "<tag> port <port> <device> <cameras>"
+                                      line per device, then "<tag> ok")
+<tag> send <port> <camera> <byte>... (message body in hex, without header and
+                                      terminator, e.g. "7 send 0 1 01 04 07 02";
+                                      answered with "<tag> done", "<tag> data
+                                      <reply bytes>" or "<tag> fail")
+<tag> lock <port> <camera> <axis>    (pantilt, zoom or focus: motion commands
+<tag> unlock <port> <camera> <axis>   for a locked axis from other clients are
+                                      answered with "<tag> locked <client>")
+<tag> subscribe <port> <camera>      (report state changes of this camera)
+<tag> unsubscribe <port> <camera>
+
+Events for subscribers:
+=======================
+event <port> <camera> done <bytes>   (a command from any client completed)
+event <port> <camera> data <bytes>   (an inquiry answer)
+event <port> <camera> lock <axis> <client>   (-1 when released)
+
+Locks and subscriptions end when the client disconnects. Output to a
+client that does not read is dropped rather than stalling the others.
+*/
+
+#include "../visca/libvisca.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define VISCAD_SOCKET       "viscad.sock"   /* in $XDG_RUNTIME_DIR */
+#define VISCAD_RETRY_MS     2000
+#define VISCAD_MAX_PORTS    8
+#define VISCAD_MAX_CLIENTS  32
+#define VISCAD_LINE         512
+#define VISCAD_REQUESTS     256
+
+/*motion axes that can be locked*/
+#define VISCAD_AXIS_PANTILT 0
+#define VISCAD_AXIS_ZOOM    1
+#define VISCAD_AXIS_FOCUS   2
+#define VISCAD_AXES         3
+
+static const char *axis_names[VISCAD_AXES] = { "pantilt", "zoom", "focus" };
+
+typedef struct {
+  int fd;                  /* -1: free slot */
+  unsigned int gen;        /* bumped when the slot is reused */
+  char in[VISCAD_LINE];
+  size_t in_len;
+  unsigned char subscribed[VISCAD_MAX_PORTS];   /* one bit per camera */
+} client_t;
+
+typedef struct {
+  char *device;
+  VISCAInterface_t iface;
+  VISCACamera_t cameras[8];
+  int ncameras;
+  int reactor_port;
+  int down;                    /* I/O failed: reopened every VISCAD_RETRY_MS */
+  int owner[8][VISCAD_AXES];   /* client slot holding the axis, -1 free */
+} port_t;
+
+/*a message on its way to the reactor, and back to its client*/
+typedef struct {
+  int client;
+  unsigned int gen;
+  char tag[32];
+  int port;
+  int camera;
+  VISCAPacket_t packet;
+} request_t;
+
+/*Everything below is guarded by lock*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static port_t ports[VISCAD_MAX_PORTS];
+static int nports = 0;
+static client_t clients[VISCAD_MAX_CLIENTS];
+static request_t *requests[VISCAD_REQUESTS];
+static int req_head = 0, req_tail = 0;
+
+static VISCAReactor_t *reactor;
+
+/*print usage message and exit*/
+static void print_usage() {
+  fprintf(stderr,"Usage: viscad [-s <socket path>] <serial port device> [<device> ...]\n");
+  exit(1);
+}
+
+/* write a line to a client if it is still the one that asked
+ * (caller holds lock); a client that does not read loses output
+ */
+static void client_printf(int slot, unsigned int gen, const char *fmt, ...) {
+  char line[VISCAD_LINE * 2];
+  va_list ap;
+  int length;
+
+  if (slot < 0 || clients[slot].fd < 0 || clients[slot].gen != gen)
+    return;
+  va_start(ap, fmt);
+  length = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+  va_end(ap);
+  if (length < 0)
+    return;
+  if (length > (int)sizeof(line) - 2)
+    length = sizeof(line) - 2;
+  line[length++] = '\n';
+  send(clients[slot].fd, line, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/* format bytes as hex into buf */
+static void hex_string(char *buf, size_t size, const unsigned char *bytes, uint32_t length) {
+  uint32_t i;
+  size_t pos = 0;
+
+  buf[0] = '\0';
+  for (i = 0; i < length && pos + 4 < size; i++)
+    pos += snprintf(buf + pos, size - pos, i ? " %02x" : "%02x", bytes[i]);
+}
+
+/* tell every subscriber of a camera (caller holds lock) */
+static void publish(int port, int camera, const char *fmt, ...) {
+  char what[VISCAD_LINE];
+  va_list ap;
+  int i;
+
+  va_start(ap, fmt);
+  vsnprintf(what, sizeof(what), fmt, ap);
+  va_end(ap);
+  for (i = 0; i < VISCAD_MAX_CLIENTS; i++)
+    if (clients[i].fd >= 0 && (clients[i].subscribed[port] & (1 << camera)))
+      client_printf(i, clients[i].gen, "event %i %i %s", port, camera, what);
+}
+
+/* which lockable axis a message body moves, or -1 */
+static int packet_axis(const VISCAPacket_t *packet) {
+  const unsigned char *b = packet->bytes + 1;
+
+  if (packet->length < 4 || b[0] != VISCA_COMMAND)
+    return -1;
+  if (b[1] == VISCA_CATEGORY_PAN_TILTER)
+    return VISCAD_AXIS_PANTILT;
+  if (b[1] == VISCA_CATEGORY_CAMERA1 && (b[2] == VISCA_ZOOM || b[2] == VISCA_ZOOM_VALUE))
+    return VISCAD_AXIS_ZOOM;
+  if (b[1] == VISCA_CATEGORY_CAMERA1 && (b[2] == VISCA_FOCUS || b[2] == VISCA_FOCUS_VALUE))
+    return VISCAD_AXIS_FOCUS;
+  return -1;
+}
+
+/*-------------------------------------------*/
+/* Devices                                   */
+/*-------------------------------------------*/
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* open a device, find its cameras and hand it to the reactor; 0 on
+ * failure. The interface is the reactor thread's alone, so this runs
+ * without lock; only the camera count is published under it.
+ */
+static int port_connect(port_t *p) {
+  int camera_num, i;
+
+  if (VISCA_open_serial(&p->iface, p->device) != VISCA_SUCCESS) {
+    fprintf(stderr, "viscad: unable to open serial device %s\n", p->device);
+    return 0;
+  }
+  p->iface.broadcast = 0;
+  VISCA_set_address(&p->iface, &camera_num);
+  if (VISCA_set_address(&p->iface, &camera_num) != VISCA_SUCCESS
+      || camera_num < 1 || camera_num > 7) {
+    fprintf(stderr, "viscad: unable to set address on %s\n", p->device);
+    VISCA_close_serial(&p->iface);
+    return 0;
+  }
+  for (i = 1; i <= camera_num; i++) {
+    p->cameras[i].address = i;
+    if (VISCA_clear(&p->iface, &p->cameras[i]) != VISCA_SUCCESS) {
+      fprintf(stderr, "viscad: unable to clear camera %i on %s\n", i, p->device);
+      VISCA_close_serial(&p->iface);
+      return 0;
+    }
+  }
+  if (VISCA_reactor_add(reactor, &p->iface, &p->reactor_port) != VISCA_SUCCESS) {
+    fprintf(stderr, "viscad: too many devices\n");
+    VISCA_close_serial(&p->iface);
+    return 0;
+  }
+  pthread_mutex_lock(&lock);
+  p->ncameras = camera_num;
+  p->down = 0;
+  pthread_mutex_unlock(&lock);
+  return 1;
+}
+
+/* take ports whose I/O failed out of the reactor, and try to bring them
+ * back once their retry is due (reactor thread, without lock); returns
+ * whether a port is still down
+ */
+static int port_supervise(void) {
+  static uint64_t retry_at[VISCAD_MAX_PORTS];
+  port_t *p;
+  int i, down = 0;
+
+  for (i = 0; i < nports; i++) {
+    p = &ports[i];
+    if (!p->down && VISCA_reactor_port_alive(reactor, p->reactor_port) != VISCA_SUCCESS) {
+      fprintf(stderr, "viscad: lost %s, retrying\n", p->device);
+      VISCA_reactor_remove(reactor, p->reactor_port);
+      VISCA_close_serial(&p->iface);
+      pthread_mutex_lock(&lock);
+      p->down = 1;
+      pthread_mutex_unlock(&lock);
+      retry_at[i] = now_ms() + VISCAD_RETRY_MS;
+    }
+    if (p->down && now_ms() >= retry_at[i]) {
+      if (port_connect(p))
+        fprintf(stderr, "viscad: %s is back\n", p->device);
+      else
+        retry_at[i] = now_ms() + VISCAD_RETRY_MS;
+    }
+    down |= p->down;
+  }
+  return down;
+}
+
+/*-------------------------------------------*/
+/* Reactor thread                            */
+/*-------------------------------------------*/
+
+static void request_done(void *user, int rport, uint32_t camera, uint32_t status,
+                         const unsigned char *reply, uint32_t length) {
+  request_t *req = (request_t *)user;
+  char hex[VISCAD_LINE];
+
+  (void)rport;
+  (void)camera;
+  pthread_mutex_lock(&lock);
+  if (status != VISCA_SUCCESS) {
+    client_printf(req->client, req->gen, "%s fail", req->tag);
+  } else if (req->packet.bytes[1] == VISCA_INQUIRY) {
+    hex_string(hex, sizeof(hex), reply, length);
+    client_printf(req->client, req->gen, "%s data %s", req->tag, hex);
+    publish(req->port, req->camera, "data %s", hex);
+  } else {
+    client_printf(req->client, req->gen, "%s done", req->tag);
+    hex_string(hex, sizeof(hex), req->packet.bytes + 1, req->packet.length - 1);
+    publish(req->port, req->camera, "done %s", hex);
+  }
+  pthread_mutex_unlock(&lock);
+  free(req);
+}
+
+static void *reactor_main(void *arg) {
+  request_t *req;
+  port_t *p;
+  int down;
+
+  (void)arg;
+  for (;;) {
+    down = port_supervise();
+    /*hand queued requests to the reactor; a port that is down fails them*/
+    pthread_mutex_lock(&lock);
+    while (req_head != req_tail) {
+      req = requests[req_head];
+      req_head = (req_head + 1) % VISCAD_REQUESTS;
+      p = &ports[req->port];
+      if (p->down
+          || VISCA_reactor_submit(reactor, p->reactor_port, &p->cameras[req->camera],
+                                  &req->packet, request_done, req) != VISCA_SUCCESS) {
+        client_printf(req->client, req->gen, "%s fail", req->tag);
+        free(req);
+      }
+    }
+    pthread_mutex_unlock(&lock);
+    /*callbacks take the lock themselves*/
+    VISCA_reactor_run(reactor, down ? VISCAD_RETRY_MS * 1000 : 0);
+  }
+  return NULL;
+}
+
+/*-------------------------------------------*/
+/* Client requests                           */
+/*-------------------------------------------*/
+
+/* parse "<port> <camera>"; answers the client itself when they are wrong */
+static int parse_target(int slot, const char *tag, int *port, int *camera) {
+  char *a = strtok(NULL, " "), *b = strtok(NULL, " ");
+
+  if (a == NULL || b == NULL) {
+    client_printf(slot, clients[slot].gen, "%s error missing port or camera", tag);
+    return 0;
+  }
+  *port = atoi(a);
+  *camera = atoi(b);
+  if (*port < 0 || *port >= nports || *camera < 1 || *camera > ports[*port].ncameras) {
+    client_printf(slot, clients[slot].gen, "%s error no such camera", tag);
+    return 0;
+  }
+  return 1;
+}
+
+static int parse_axis(void) {
+  char *name = strtok(NULL, " ");
+  int axis;
+
+  for (axis = 0; name != NULL && axis < VISCAD_AXES; axis++)
+    if (strcmp(name, axis_names[axis]) == 0)
+      return axis;
+  return -1;
+}
+
+static void do_send(int slot, const char *tag) {
+  request_t *req;
+  char *byte, *end;
+  long value;
+  int port, camera, axis, next;
+
+  if (!parse_target(slot, tag, &port, &camera))
+    return;
+  req = (request_t *)calloc(1, sizeof(request_t));
+  if (req == NULL)
+    return;
+  _VISCA_init_packet(&req->packet);
+  for (byte = strtok(NULL, " "); byte != NULL; byte = strtok(NULL, " ")) {
+    value = strtol(byte, &end, 16);
+    if (*end != '\0' || value < 0 || value > 0xfe
+        || req->packet.length >= sizeof(req->packet.bytes) - 1) {
+      client_printf(slot, clients[slot].gen, "%s error bad message", tag);
+      free(req);
+      return;
+    }
+    _VISCA_append_byte(&req->packet, (unsigned char)value);
+  }
+  if (req->packet.length < 2) {
+    client_printf(slot, clients[slot].gen, "%s error empty message", tag);
+    free(req);
+    return;
+  }
+
+  /*someone else holds this axis*/
+  axis = packet_axis(&req->packet);
+  if (axis >= 0 && ports[port].owner[camera][axis] >= 0
+      && ports[port].owner[camera][axis] != slot) {
+    client_printf(slot, clients[slot].gen, "%s locked %i", tag, ports[port].owner[camera][axis]);
+    free(req);
+    return;
+  }
+
+  req->client = slot;
+  req->gen = clients[slot].gen;
+  snprintf(req->tag, sizeof(req->tag), "%s", tag);
+  req->port = port;
+  req->camera = camera;
+  next = (req_tail + 1) % VISCAD_REQUESTS;
+  if (next == req_head) {
+    client_printf(slot, clients[slot].gen, "%s fail", tag);
+    free(req);
+    return;
+  }
+  requests[req_tail] = req;
+  req_tail = next;
+  VISCA_reactor_wakeup(reactor);
+}
+
+static void do_lock(int slot, const char *tag, int take) {
+  int port, camera, axis, *owner;
+
+  if (!parse_target(slot, tag, &port, &camera))
+    return;
+  if ((axis = parse_axis()) < 0) {
+    client_printf(slot, clients[slot].gen, "%s error axis is pantilt, zoom or focus", tag);
+    return;
+  }
+  owner = &ports[port].owner[camera][axis];
+  if (*owner >= 0 && *owner != slot) {
+    client_printf(slot, clients[slot].gen, "%s locked %i", tag, *owner);
+    return;
+  }
+  if (*owner != (take ? slot : -1)) {
+    *owner = take ? slot : -1;
+    publish(port, camera, "lock %s %i", axis_names[axis], *owner);
+  }
+  client_printf(slot, clients[slot].gen, "%s ok", tag);
+}
+
+static void do_subscribe(int slot, const char *tag, int on) {
+  int port, camera;
+
+  if (!parse_target(slot, tag, &port, &camera))
+    return;
+  if (on)
+    clients[slot].subscribed[port] |= 1 << camera;
+  else
+    clients[slot].subscribed[port] &= ~(1 << camera);
+  client_printf(slot, clients[slot].gen, "%s ok", tag);
+}
+
+/* one request line (caller holds lock) */
+static void do_line(int slot, char *line) {
+  char *tag = strtok(line, " "), *command = strtok(NULL, " ");
+  int i;
+
+  if (tag == NULL)
+    return;
+  if (command == NULL) {
+    client_printf(slot, clients[slot].gen, "%s error missing command", tag);
+  } else if (strcmp(command, "send") == 0) {
+    do_send(slot, tag);
+  } else if (strcmp(command, "lock") == 0) {
+    do_lock(slot, tag, 1);
+  } else if (strcmp(command, "unlock") == 0) {
+    do_lock(slot, tag, 0);
+  } else if (strcmp(command, "subscribe") == 0) {
+    do_subscribe(slot, tag, 1);
+  } else if (strcmp(command, "unsubscribe") == 0) {
+    do_subscribe(slot, tag, 0);
+  } else if (strcmp(command, "ports") == 0) {
+    for (i = 0; i < nports; i++)
+      client_printf(slot, clients[slot].gen, "%s port %i %s %i", tag, i,
+                    ports[i].device, ports[i].ncameras);
+    client_printf(slot, clients[slot].gen, "%s ok", tag);
+  } else {
+    client_printf(slot, clients[slot].gen, "%s error unknown command %s", tag, command);
+  }
+}
+
+/* drop a client with its locks and subscriptions (caller holds lock) */
+static void client_close(int slot) {
+  int p, c, axis;
+
+  for (p = 0; p < nports; p++)
+    for (c = 1; c <= ports[p].ncameras; c++)
+      for (axis = 0; axis < VISCAD_AXES; axis++)
+        if (ports[p].owner[c][axis] == slot) {
+          ports[p].owner[c][axis] = -1;
+          publish(p, c, "lock %s -1", axis_names[axis]);
+        }
+  close(clients[slot].fd);
+  clients[slot].fd = -1;
+  clients[slot].gen++;
+  clients[slot].in_len = 0;
+  memset(clients[slot].subscribed, 0, sizeof(clients[slot].subscribed));
+}
+
+/* read what a client sent and run every complete line (caller holds lock) */
+static void client_read(int slot) {
+  client_t *cl = &clients[slot];
+  char *start, *newline;
+  ssize_t n;
+
+  n = read(cl->fd, cl->in + cl->in_len, sizeof(cl->in) - 1 - cl->in_len);
+  if (n <= 0) {
+    if (n == 0 || (errno != EAGAIN && errno != EINTR))
+      client_close(slot);
+    return;
+  }
+  cl->in_len += n;
+  cl->in[cl->in_len] = '\0';
+  start = cl->in;
+  while ((newline = strchr(start, '\n')) != NULL) {
+    *newline = '\0';
+    if (newline > start && newline[-1] == '\r')
+      newline[-1] = '\0';
+    do_line(slot, start);
+    if (cl->fd < 0)
+      return;
+    start = newline + 1;
+  }
+  cl->in_len -= start - cl->in;
+  memmove(cl->in, start, cl->in_len);
+  /*a line longer than the buffer is thrown away*/
+  if (cl->in_len == sizeof(cl->in) - 1)
+    cl->in_len = 0;
+}
+
+/*-------------------------------------------*/
+/* Start up                                  */
+/*-------------------------------------------*/
+
+/* open a device for the first time; 0 on failure */
+static int open_port(port_t *p, char *device) {
+  int i, axis;
+
+  p->device = device;
+  for (i = 0; i < 8; i++)
+    for (axis = 0; axis < VISCAD_AXES; axis++)
+      p->owner[i][axis] = -1;
+  return port_connect(p);
+}
+
+int main(int argc, char **argv) {
+  char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  struct sockaddr_un addr;
+  struct pollfd pfd[VISCAD_MAX_CLIENTS + 1];
+  int slots[VISCAD_MAX_CLIENTS + 1];
+  struct stat st;
+  pthread_t thread;
+  mode_t mask;
+  int listener, bound, fd, i, n;
+
+  path[0] = '\0';
+  if (dir != NULL && *dir != '\0')
+    snprintf(path, sizeof(path), "%s/%s", dir, VISCAD_SOCKET);
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    snprintf(path, sizeof(path), "%s", argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if (argc < 2 || argc - 1 > VISCAD_MAX_PORTS)
+    print_usage();
+  if (path[0] == '\0') {
+    fprintf(stderr, "viscad: XDG_RUNTIME_DIR is not set, give a socket path with -s\n");
+    exit(1);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  if (VISCA_reactor_new(&reactor) != VISCA_SUCCESS) {
+    fprintf(stderr, "viscad: unable to create the reactor\n");
+    exit(1);
+  }
+  for (i = 1; i < argc; i++) {
+    if (!open_port(&ports[nports], argv[i]))
+      exit(1);
+    nports++;
+  }
+  for (i = 0; i < VISCAD_MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  /*a socket left by an earlier run goes, anything else stays*/
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+  /*created for the owner only: no window in which others can connect*/
+  mask = umask(0177);
+  bound = listener < 0 ? -1 : bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+  if (listener < 0 || bound < 0 || listen(listener, 8) < 0) {
+    fprintf(stderr, "viscad: unable to listen on %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+  if (pthread_create(&thread, NULL, reactor_main, NULL) != 0) {
+    fprintf(stderr, "viscad: unable to start the reactor thread\n");
+    exit(1);
+  }
+  fprintf(stderr, "viscad: serving %i device(s) on %s\n", nports, path);
+
+  for (;;) {
+    pfd[0].fd = listener;
+    pfd[0].events = POLLIN;
+    n = 1;
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < VISCAD_MAX_CLIENTS; i++) {
+      if (clients[i].fd < 0)
+        continue;
+      pfd[n].fd = clients[i].fd;
+      pfd[n].events = POLLIN;
+      slots[n++] = i;
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (poll(pfd, n, -1) < 0 && errno != EINTR)
+      break;
+
+    pthread_mutex_lock(&lock);
+    for (i = 1; i < n; i++)
+      if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))
+        client_read(slots[i]);
+    if (pfd[0].revents & POLLIN) {
+      fd = accept(listener, NULL, NULL);
+      for (i = 0; fd >= 0 && i < VISCAD_MAX_CLIENTS && clients[i].fd >= 0; i++)
+        ;
+      if (fd >= 0 && i == VISCAD_MAX_CLIENTS) {
+        close(fd);
+      } else if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        clients[i].fd = fd;
+      }
+    }
+    pthread_mutex_unlock(&lock);
+  }
+  unlink(path);
+  return 0;
+}
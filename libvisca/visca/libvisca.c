@@ -34,7 +34,7 @@
 /*      PRIVATE FUNCTIONS       */
 /********************************/
 
-void
+VISCA_API void
 _VISCA_append_byte(VISCAPacket_t *packet, unsigned char byte)
 {
   packet->bytes[packet->length]=byte;
@@ -42,7 +42,7 @@ _VISCA_append_byte(VISCAPacket_t *packet, unsigned char byte)
 }
 
 
-void
+VISCA_API void
 _VISCA_init_packet(VISCAPacket_t *packet)
 {
   // we start writing at byte 1, the first byte will be filled by the
@@ -51,17 +51,57 @@ _VISCA_init_packet(VISCAPacket_t *packet)
 }
 
 
+/* The packet in ibuf completes a command that returned at its ACK: keep it
+   for VISCA_get_completion(). */
+static int
+_VISCA_defer_completion(VISCAInterface_t *iface)
+{
+  int address=(iface->ibuf[0]>>4)&0x07;
+  int socket=iface->ibuf[1]&0x0F;
+  VISCACompletion_t *done;
+
+  if ((iface->type!=VISCA_RESPONSE_COMPLETED)&&(iface->type!=VISCA_RESPONSE_ERROR))
+    return 0;
+  if ((socket==0)||!(iface->deferred[address]&(1<<socket)))
+    return 0;
+  iface->deferred[address]&=~(1<<socket);
+
+  // a full queue loses its oldest entry
+  if ((iface->done_tail+1)%VISCA_COMPLETION_QUEUE==iface->done_head)
+    iface->done_head=(iface->done_head+1)%VISCA_COMPLETION_QUEUE;
+  done=&iface->done[iface->done_tail];
+  done->address=address;
+  done->socket=socket;
+  done->type=iface->type;
+  done->error=(iface->type==VISCA_RESPONSE_ERROR) ? iface->ibuf[2] : 0;
+  iface->done_tail=(iface->done_tail+1)%VISCA_COMPLETION_QUEUE;
+  return 1;
+}
+
 VISCA_API uint32_t
 _VISCA_get_reply(VISCAInterface_t *iface, VISCACamera_t *camera)
 {
+  int acked=0;
+
   // first message: -------------------
+  iface->completing=0;
   if (_VISCA_get_packet(iface)!=VISCA_SUCCESS) 
     return VISCA_FAILURE;
   iface->type=iface->ibuf[1]&0xF0;
 
-  // skip ack messages
-  while (iface->type==VISCA_RESPONSE_ACK)
+  // skip ack messages (in ACK-return mode the ack is the reply), and
+  // completions of earlier commands that returned at theirs
+  while ((iface->type==VISCA_RESPONSE_ACK)||_VISCA_defer_completion(iface))
     {
+      if ((iface->type==VISCA_RESPONSE_ACK)&&iface->ack_mode)
+        {
+          iface->deferred[(iface->ibuf[0]>>4)&0x07]|=1<<(iface->ibuf[1]&0x0F);
+          return VISCA_SUCCESS;
+        }
+      // once ACKed, the completion may take as long as the move
+      if (iface->type==VISCA_RESPONSE_ACK)
+        acked=1;
+      iface->completing=acked;
       if (_VISCA_get_packet(iface)!=VISCA_SUCCESS) 
         return VISCA_FAILURE;
       iface->type=iface->ibuf[1]&0xF0;
@@ -97,6 +137,50 @@ _VISCA_send_packet_with_reply(VISCAInterface_t *iface, VISCACamera_t *camera, VI
   return VISCA_SUCCESS;    
 }
 
+VISCA_API uint32_t
+_VISCA_send_packet_with_ack(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t *packet)
+{
+  int backup=iface->ack_mode;
+  uint32_t err;
+
+  iface->ack_mode=1;
+  err=_VISCA_send_packet_with_reply(iface,camera,packet);
+  iface->ack_mode=backup;
+  return err;
+}
+
+VISCA_API uint32_t
+VISCA_set_ack_mode(VISCAInterface_t *iface, int on)
+{
+  iface->ack_mode=(on!=0);
+  return VISCA_SUCCESS;
+}
+
+VISCA_API uint32_t
+VISCA_get_completion(VISCAInterface_t *iface, VISCACompletion_t *done, int wait)
+{
+  if (iface->done_head==iface->done_tail)
+    {
+      if (!wait)
+        return VISCA_FAILURE;
+      if (_VISCA_get_packet(iface)!=VISCA_SUCCESS)
+        return VISCA_FAILURE;
+      iface->type=iface->ibuf[1]&0xF0;
+      if (!_VISCA_defer_completion(iface))
+        {
+          // not one of ours: hand it back as it is, it stays in ibuf
+          done->address=(iface->ibuf[0]>>4)&0x07;
+          done->socket=iface->ibuf[1]&0x0F;
+          done->type=iface->type;
+          done->error=(iface->type==VISCA_RESPONSE_ERROR) ? iface->ibuf[2] : 0;
+          return VISCA_SUCCESS;
+        }
+    }
+  *done=iface->done[iface->done_head];
+  iface->done_head=(iface->done_head+1)%VISCA_COMPLETION_QUEUE;
+  return VISCA_SUCCESS;
+}
+
 
 /****************************************************************************/
 /*                           PUBLIC FUNCTIONS                               */
@@ -372,6 +372,20 @@
 extern "C" {
 #endif
 
+/* ACK-return mode: a command returns once the camera ACKs it, and its
+ * completion (or error) is collected later with VISCA_get_completion().
+ */
+#define VISCA_COMPLETION_QUEUE 16
+
+typedef struct _VISCA_completion
+{
+  int address;   /* camera */
+  int socket;
+  int type;      /* VISCA_RESPONSE_COMPLETED or VISCA_RESPONSE_ERROR, any
+                    other reply type when waiting read something else */
+  int error;     /* error code of an error reply */
+} VISCACompletion_t;
+
 #ifdef VISCA_WIN
 
 #include <windows.h>
@@ -398,6 +412,17 @@ typedef struct _VISCA_interface
   unsigned char ibuf[VISCA_INPUT_BUFFER_SIZE];
   int bytes;
   int type;
+
+  // ACK-return mode: sockets of commands still running, by camera, and
+  // completions that came in while a call waited for something else
+  int ack_mode;
+  int deferred[8];
+  VISCACompletion_t done[VISCA_COMPLETION_QUEUE];
+  int done_head, done_tail;
+
+  // the next packet read is a completion after an ACK: it may take as
+  // long as the move
+  int completing;
 } VISCAInterface_t;
 
 #ifdef _MSC_VER
@@ -449,6 +474,17 @@ typedef struct _VISCA_interface
 	unsigned char ibuf[VISCA_INPUT_BUFFER_SIZE];
 	int bytes;
 	int type;
+
+	// ACK-return mode: sockets of commands still running, by camera, and
+	// completions that came in while a call waited for something else
+	int ack_mode;
+	int deferred[8];
+	VISCACompletion_t done[VISCA_COMPLETION_QUEUE];
+	int done_head, done_tail;
+
+	// the next packet read is a completion after an ACK: it may take as
+	// long as the move
+	int completing;
 } VISCAInterface_t;
 
 #else
@@ -459,6 +495,11 @@ typedef struct _VISCA_interface
 /* timeout in us */
 #define VISCA_SERIAL_WAIT              100000
 
+/* longest wait in us for a first reply (ACK or inquiry answer), and for
+   the completion that follows an ACK, a move's included */
+#define VISCA_ACK_WAIT                 500000
+#define VISCA_REPLY_WAIT               30000000
+
 /* size of the local packet buffer */
 #define VISCA_INPUT_BUFFER_SIZE          1024
 
@@ -480,6 +521,17 @@ typedef struct _VISCA_interface
   uint32_t bytes;
   uint32_t type;
 
+  // ACK-return mode: sockets of commands still running, by camera, and
+  // completions that came in while a call waited for something else
+  int ack_mode;
+  int deferred[8];
+  VISCACompletion_t done[VISCA_COMPLETION_QUEUE];
+  int done_head, done_tail;
+
+  // the next packet read is a completion after an ACK: it may take as
+  // long as the move
+  int completing;
+
 } VISCAInterface_t;
 
 #endif
@@ -542,6 +594,38 @@ _VISCA_send_packet(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t
 VISCA_API uint32_t
 _VISCA_get_packet(VISCAInterface_t *iface);
 
+/* Packet helpers for callers that compose their own messages: the header
+   byte and the terminator are added by _VISCA_send_packet. */
+VISCA_API void
+_VISCA_init_packet(VISCAPacket_t *packet);
+
+VISCA_API void
+_VISCA_append_byte(VISCAPacket_t *packet, unsigned char byte);
+
+VISCA_API uint32_t
+_VISCA_get_reply(VISCAInterface_t *iface, VISCACamera_t *camera);
+
+VISCA_API uint32_t
+_VISCA_send_packet_with_reply(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t *packet);
+
+/* Like _VISCA_send_packet_with_reply, in ACK-return mode for this call only.
+   A command returns with its ACK in iface->ibuf (socket in the low nibble of
+   ibuf[1]); an inquiry or an error before the ACK returns as usual. */
+VISCA_API uint32_t
+_VISCA_send_packet_with_ack(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t *packet);
+
+/* Switch ACK-return mode on or off for every call on the interface. */
+VISCA_API uint32_t
+VISCA_set_ack_mode(VISCAInterface_t *iface, int on);
+
+/* Next completion of a command that returned at its ACK. Without wait, only
+   completions already read are returned; with wait, one packet is read if
+   there are none (blocking) and returned even when it is not one: its type
+   is then the packet's own (an ACK, a stray reply...) and the packet stays
+   in iface->ibuf. VISCA_FAILURE means nothing could be read. */
+VISCA_API uint32_t
+VISCA_get_completion(VISCAInterface_t *iface, VISCACompletion_t *done, int wait);
+
 VISCA_API uint32_t
 VISCA_open_serial(VISCAInterface_t *iface, const char *device_name);
 
@@ -1149,6 +1233,66 @@ VISCA_get_register(VISCAInterface_t *iface, VISCACamera_t *camera, uint8_t reg_n
 VISCA_API uint32_t
 VISCA_usleep(uint32_t useconds);
 
+#ifdef VISCA_POSIX
+
+/* REACTOR -- serves many interfaces from a single thread.
+ *
+ * Each added interface gets its own framer, send queue and table of
+ * messages in flight (one awaiting its first reply and one per command
+ * socket, per camera), so every camera on every port can be kept busy
+ * without blocking. Interfaces are opened and initialised with the blocking
+ * functions above, then handed to the reactor; they must not be used
+ * directly again until removed. All functions except VISCA_reactor_wakeup
+ * must be called from the thread that runs the reactor.
+ */
+
+#define VISCA_REACTOR_MAX_PORTS          32
+#define VISCA_REACTOR_QUEUE              64
+
+/* timeouts in us: first reply (ACK or inquiry data), then completion */
+#define VISCA_REACTOR_ACK_WAIT           500000
+#define VISCA_REACTOR_COMPLETION_WAIT    30000000
+
+typedef struct _VISCA_reactor VISCAReactor_t;
+
+/* Called once per submitted message. status is VISCA_SUCCESS for a
+   completion or inquiry reply, VISCA_FAILURE for an error reply, a timeout
+   or a dead port; reply holds the camera's message (length 0 if none). */
+typedef void (*VISCAReactorCallback_t)(void *user, int port, uint32_t camera,
+                                       uint32_t status, const unsigned char *reply,
+                                       uint32_t length);
+
+VISCA_API uint32_t
+VISCA_reactor_new(VISCAReactor_t **reactor);
+
+VISCA_API void
+VISCA_reactor_free(VISCAReactor_t *reactor);
+
+VISCA_API uint32_t
+VISCA_reactor_add(VISCAReactor_t *reactor, VISCAInterface_t *iface, int *port);
+
+VISCA_API uint32_t
+VISCA_reactor_remove(VISCAReactor_t *reactor, int port);
+
+/* VISCA_FAILURE once I/O on a port failed: everything on it has been
+   failed, and it stays dead until removed (and, reopened, added again) */
+VISCA_API uint32_t
+VISCA_reactor_port_alive(VISCAReactor_t *reactor, int port);
+
+VISCA_API uint32_t
+VISCA_reactor_submit(VISCAReactor_t *reactor, int port, VISCACamera_t *camera,
+                     VISCAPacket_t *packet, VISCAReactorCallback_t callback, void *user);
+
+/* One pass: waits for I/O or the next timeout, but at most timeout_us
+   (0: no limit), then reads, writes and runs callbacks. */
+VISCA_API uint32_t
+VISCA_reactor_run(VISCAReactor_t *reactor, uint32_t timeout_us);
+
+VISCA_API uint32_t
+VISCA_reactor_wakeup(VISCAReactor_t *reactor);
+
+#endif /* VISCA_POSIX */
+
 #ifdef __cplusplus
 } /* closing brace for extern "C" */
 #endif
@@ -137,6 +137,9 @@ VISCA_open_serial(VISCAInterface_t *iface, const char *device_name)
 
     iface->port_fd = UART_VISCA;
     iface->address=0;
+    iface->ack_mode=0;
+    memset(iface->deferred, 0, sizeof(iface->deferred));
+    iface->done_head=iface->done_tail=0;
 
     return VISCA_SUCCESS;
 }
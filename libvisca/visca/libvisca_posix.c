@@ -25,13 +25,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
-
-/* implemented in libvisca.c
- */
-void _VISCA_append_byte(VISCAPacket_t *packet, unsigned char byte);
-void _VISCA_init_packet(VISCAPacket_t *packet);
-unsigned int _VISCA_get_reply(VISCAInterface_t *iface, VISCACamera_t *camera);
-unsigned int _VISCA_send_packet_with_reply(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t *packet);
+#include <poll.h>
+#include <time.h>
 
 
 
@@ -92,25 +87,69 @@ _VISCA_send_packet(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t
 }
 
 
+static uint64_t
+_VISCA_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+// wait until a byte can be read or the deadline passes; an error or hangup
+// means the device went away (e.g. a USB adapter was unplugged)
+static uint32_t
+_VISCA_wait_byte(VISCAInterface_t *iface, uint64_t deadline)
+{
+    struct pollfd pfd;
+    uint64_t now;
+    int ret;
+
+    pfd.fd=iface->port_fd;
+    pfd.events=POLLIN;
+    while (1) {
+	now=_VISCA_now_ms();
+	if (now>=deadline)
+	    return VISCA_FAILURE;
+	ret=poll(&pfd, 1, (int)(deadline-now));
+	if (ret<0 && errno!=EINTR)
+	    return VISCA_FAILURE;
+	if (ret<=0)
+	    continue;
+	if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+	    return VISCA_FAILURE;
+	if (pfd.revents & POLLIN)
+	    return VISCA_SUCCESS;
+    }
+}
+
 uint32_t
 _VISCA_get_packet(VISCAInterface_t *iface)
 {
     int pos=0;
     int bytes_read;
+    uint64_t deadline=_VISCA_now_ms()
+	+(iface->completing ? VISCA_REPLY_WAIT : VISCA_ACK_WAIT)/1000;
 
-    // wait for message
-    ioctl(iface->port_fd, FIONREAD, &(iface->bytes));
-    while (iface->bytes==0) {
-	usleep(0);
-	ioctl(iface->port_fd, FIONREAD, &(iface->bytes));
-    }
+    // a camera that stops answering fails the call instead of blocking the
+    // caller for good; only a completion gets the long bound
+    iface->completing=0;
+    if (_VISCA_wait_byte(iface, deadline)!=VISCA_SUCCESS)
+	return VISCA_FAILURE;
 
     // get octets one by one
     bytes_read=read(iface->port_fd, iface->ibuf, 1);
+    if (bytes_read<=0)
+	return VISCA_FAILURE;
     while (iface->ibuf[pos]!=VISCA_TERMINATOR) {
 	pos++;
+	if (pos>=VISCA_INPUT_BUFFER_SIZE)
+	    return VISCA_FAILURE;
+	if (_VISCA_wait_byte(iface, deadline)!=VISCA_SUCCESS)
+	    return VISCA_FAILURE;
 	bytes_read=read(iface->port_fd, &iface->ibuf[pos], 1);
-	usleep(0);
+	if (bytes_read<=0)
+	    return VISCA_FAILURE;
     }
     iface->bytes=pos+1;
 
@@ -170,6 +209,9 @@ VISCA_open_serial(VISCAInterface_t *iface, const char *device_name)
     }
   iface->port_fd = fd;
   iface->address=0;
+  iface->ack_mode=0;
+  memset(iface->deferred, 0, sizeof(iface->deferred));
+  iface->done_head=iface->done_tail=0;
 
   return VISCA_SUCCESS;
 }
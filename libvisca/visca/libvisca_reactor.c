@@ -0,0 +1,526 @@
+/*
+ * VISCA(tm) Camera Control Library
+ * Copyright (C) 2002 Damien Douxchamps 
+ *
+ * Written by Damien Douxchamps <ddouxchamps@users.sf.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "libvisca.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+
+/* Single thread event loop over many interfaces (POSIX only).
+ *
+ * VISCA lets a camera hold two commands in execution (one per socket) while
+ * it accepts further messages, and every reply names the camera it comes
+ * from. The reactor keeps, per camera, the one message that still waits for
+ * its first reply (ACK, inquiry data or error) plus the commands executing
+ * in each socket, and only sends a camera its next message once that first
+ * reply is in. Messages to one camera go out in order; cameras never wait
+ * for each other.
+ */
+
+#define VISCA_REACTOR_CAMERAS            8   /* addresses 1..7 */
+#define VISCA_REACTOR_SOCKETS            2
+#define VISCA_REACTOR_TX_SIZE            512
+
+typedef struct _VISCA_reactor_msg
+{
+  VISCAReactorCallback_t callback;
+  void *user;
+  uint32_t camera;
+  int inquiry;
+  uint64_t deadline;
+  unsigned char bytes[32];
+  uint32_t length;
+} VISCAReactorMsg_t;
+
+typedef struct _VISCA_reactor_slot
+{
+  int busy;
+  VISCAReactorMsg_t msg;
+} VISCAReactorSlot_t;
+
+typedef struct _VISCA_reactor_port
+{
+  VISCAInterface_t *iface;
+  int used;
+  int dead;                       /* I/O failed or being removed */
+  int flags;                      /* file status flags to restore */
+
+  /* framer */
+  unsigned char rx[VISCA_INPUT_BUFFER_SIZE];
+  uint32_t rx_len;
+
+  /* send queue, and bytes dispatched but not yet written */
+  VISCAReactorMsg_t queue[VISCA_REACTOR_QUEUE];
+  uint32_t head, count;
+  unsigned char tx[VISCA_REACTOR_TX_SIZE];
+  uint32_t tx_len, tx_pos;
+
+  /* in flight, per camera */
+  VISCAReactorSlot_t pending[VISCA_REACTOR_CAMERAS];
+  VISCAReactorSlot_t sockets[VISCA_REACTOR_CAMERAS][VISCA_REACTOR_SOCKETS];
+} VISCAReactorPort_t;
+
+struct _VISCA_reactor
+{
+  VISCAReactorPort_t ports[VISCA_REACTOR_MAX_PORTS];
+  int wakeup[2];
+  /* built in each pass; index 0 is the wakeup pipe */
+  struct pollfd pfd[VISCA_REACTOR_MAX_PORTS+1];
+  int pfd_port[VISCA_REACTOR_MAX_PORTS+1];
+};
+
+
+static uint64_t
+_VISCA_reactor_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+
+static void
+_VISCA_reactor_finish(VISCAReactor_t *reactor, int port, VISCAReactorSlot_t *slot,
+                      uint32_t status, const unsigned char *reply, uint32_t length)
+{
+  VISCAReactorMsg_t msg=slot->msg;
+
+  (void)reactor;
+  // free the slot first: the callback may submit the next message
+  slot->busy=0;
+  if (msg.callback)
+    msg.callback(msg.user, port, msg.camera, status, reply, length);
+}
+
+
+/* fail everything queued or in flight on a port that went away or is
+   being removed; callbacks can no longer submit to it */
+static void
+_VISCA_reactor_fail_port(VISCAReactor_t *reactor, int port)
+{
+  VISCAReactorPort_t *p=&reactor->ports[port];
+  VISCAReactorSlot_t slot;
+  int cam, s;
+
+  p->dead=1;
+  for (cam=0;cam<VISCA_REACTOR_CAMERAS;cam++)
+    {
+      if (p->pending[cam].busy)
+        _VISCA_reactor_finish(reactor, port, &p->pending[cam], VISCA_FAILURE, NULL, 0);
+      for (s=0;s<VISCA_REACTOR_SOCKETS;s++)
+        if (p->sockets[cam][s].busy)
+          _VISCA_reactor_finish(reactor, port, &p->sockets[cam][s], VISCA_FAILURE, NULL, 0);
+    }
+  while (p->count>0)
+    {
+      slot.busy=1;
+      slot.msg=p->queue[p->head];
+      p->head=(p->head+1)%VISCA_REACTOR_QUEUE;
+      p->count--;
+      _VISCA_reactor_finish(reactor, port, &slot, VISCA_FAILURE, NULL, 0);
+    }
+  p->tx_len=p->tx_pos=0;
+  p->rx_len=0;
+}
+
+
+/* route one complete message from a camera to what it answers */
+static void
+_VISCA_reactor_dispatch_reply(VISCAReactor_t *reactor, int port,
+                              const unsigned char *reply, uint32_t length)
+{
+  VISCAReactorPort_t *p=&reactor->ports[port];
+  VISCAReactorSlot_t *pending, *socket=NULL;
+  uint32_t cam, type, sock;
+
+  if (length<3 || !(reply[0]&0x80))
+    return;
+  cam=(reply[0]>>4)&0x07;
+  type=reply[1]&0xF0;
+  sock=reply[1]&0x0F;
+  pending=&p->pending[cam];
+  if (sock>=1 && sock<=VISCA_REACTOR_SOCKETS)
+    socket=&p->sockets[cam][sock-1];
+
+  switch (type)
+    {
+    case VISCA_RESPONSE_ACK:
+      // the command now executes in the named socket
+      if (pending->busy && !pending->msg.inquiry && socket && !socket->busy)
+        {
+          *socket=*pending;
+          socket->msg.deadline=_VISCA_reactor_now()+VISCA_REACTOR_COMPLETION_WAIT;
+          pending->busy=0;
+        }
+      break;
+    case VISCA_RESPONSE_COMPLETED:
+      if (socket && socket->busy)
+        _VISCA_reactor_finish(reactor, port, socket, VISCA_SUCCESS, reply, length);
+      else if (pending->busy)
+        _VISCA_reactor_finish(reactor, port, pending, VISCA_SUCCESS, reply, length);
+      break;
+    case VISCA_RESPONSE_ERROR:
+      if (socket && socket->busy)
+        _VISCA_reactor_finish(reactor, port, socket, VISCA_FAILURE, reply, length);
+      else if (pending->busy)
+        _VISCA_reactor_finish(reactor, port, pending, VISCA_FAILURE, reply, length);
+      break;
+    default:
+      // address and network change broadcasts are not ours to answer
+      break;
+    }
+}
+
+
+static void
+_VISCA_reactor_read(VISCAReactor_t *reactor, int port)
+{
+  VISCAReactorPort_t *p=&reactor->ports[port];
+  unsigned char buf[256];
+  int n, i;
+
+  while ((n=read(p->iface->port_fd, buf, sizeof(buf)))>0)
+    {
+      for (i=0;i<n;i++)
+        {
+          // resynchronise on a header byte after noise or an overflow
+          if (p->rx_len==0 && !(buf[i]&0x80))
+            continue;
+          if (p->rx_len>=VISCA_INPUT_BUFFER_SIZE)
+            p->rx_len=0;
+          p->rx[p->rx_len++]=buf[i];
+          if (buf[i]==VISCA_TERMINATOR)
+            {
+              _VISCA_reactor_dispatch_reply(reactor, port, p->rx, p->rx_len);
+              p->rx_len=0;
+              if (!p->used || p->dead)
+                return;
+            }
+        }
+    }
+  // 0 just means no more data on a tty with VMIN 0; hangups are seen by poll()
+  if (n<0 && errno!=EAGAIN && errno!=EINTR)
+    _VISCA_reactor_fail_port(reactor, port);
+}
+
+
+/* move queued messages whose camera is free into the transmit buffer,
+   keeping the order of messages to the same camera */
+static void
+_VISCA_reactor_fill(VISCAReactorPort_t *p)
+{
+  VISCAReactorMsg_t *msg;
+  uint32_t i, j, blocked=0, free_socket;
+  int s;
+
+  for (i=0;i<p->count;i++)
+    {
+      msg=&p->queue[(p->head+i)%VISCA_REACTOR_QUEUE];
+      if (blocked & (1u<<msg->camera))
+        continue;
+      free_socket=msg->inquiry;
+      for (s=0;s<VISCA_REACTOR_SOCKETS;s++)
+        if (!p->sockets[msg->camera][s].busy)
+          free_socket=1;
+      if (p->pending[msg->camera].busy || !free_socket
+          || p->tx_len+msg->length>VISCA_REACTOR_TX_SIZE)
+        {
+          blocked|=1u<<msg->camera;
+          continue;
+        }
+
+      memcpy(p->tx+p->tx_len, msg->bytes, msg->length);
+      p->tx_len+=msg->length;
+      p->pending[msg->camera].busy=1;
+      p->pending[msg->camera].msg=*msg;
+      p->pending[msg->camera].msg.deadline=_VISCA_reactor_now()+VISCA_REACTOR_ACK_WAIT;
+      blocked|=1u<<msg->camera;
+
+      // close the gap in the queue
+      for (j=i;j+1<p->count;j++)
+        p->queue[(p->head+j)%VISCA_REACTOR_QUEUE]=p->queue[(p->head+j+1)%VISCA_REACTOR_QUEUE];
+      p->count--;
+      i--;
+    }
+}
+
+
+static void
+_VISCA_reactor_write(VISCAReactor_t *reactor, int port)
+{
+  VISCAReactorPort_t *p=&reactor->ports[port];
+  int n;
+
+  while (p->tx_pos<p->tx_len)
+    {
+      n=write(p->iface->port_fd, p->tx+p->tx_pos, p->tx_len-p->tx_pos);
+      if (n<0)
+        {
+          if (errno==EAGAIN || errno==EINTR)
+            return;
+          _VISCA_reactor_fail_port(reactor, port);
+          return;
+        }
+      p->tx_pos+=n;
+    }
+  p->tx_len=p->tx_pos=0;
+}
+
+
+static void
+_VISCA_reactor_expire(VISCAReactor_t *reactor, int port, uint64_t now, uint64_t *next)
+{
+  VISCAReactorPort_t *p=&reactor->ports[port];
+  VISCAReactorSlot_t *slot;
+  int cam, s;
+
+  for (cam=0;cam<VISCA_REACTOR_CAMERAS;cam++)
+    for (s=-1;s<VISCA_REACTOR_SOCKETS;s++)
+      {
+        slot= s<0 ? &p->pending[cam] : &p->sockets[cam][s];
+        if (!slot->busy)
+          continue;
+        if (slot->msg.deadline<=now)
+          _VISCA_reactor_finish(reactor, port, slot, VISCA_FAILURE, NULL, 0);
+        else if (slot->msg.deadline<*next)
+          *next=slot->msg.deadline;
+      }
+}
+
+
+/****************************************************************************/
+/*                           PUBLIC FUNCTIONS                               */
+/****************************************************************************/
+
+VISCA_API uint32_t
+VISCA_reactor_new(VISCAReactor_t **reactor)
+{
+  VISCAReactor_t *r;
+  int i;
+
+  *reactor=NULL;
+  r=(VISCAReactor_t *)calloc(1, sizeof(VISCAReactor_t));
+  if (r==NULL)
+    return VISCA_FAILURE;
+  if (pipe(r->wakeup)<0)
+    {
+      free(r);
+      return VISCA_FAILURE;
+    }
+  for (i=0;i<2;i++)
+    {
+      fcntl(r->wakeup[i], F_SETFL, fcntl(r->wakeup[i], F_GETFL) | O_NONBLOCK);
+      fcntl(r->wakeup[i], F_SETFD, FD_CLOEXEC);
+    }
+  *reactor=r;
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API void
+VISCA_reactor_free(VISCAReactor_t *reactor)
+{
+  int i;
+
+  if (reactor==NULL)
+    return;
+  for (i=0;i<VISCA_REACTOR_MAX_PORTS;i++)
+    if (reactor->ports[i].used)
+      VISCA_reactor_remove(reactor, i);
+  close(reactor->wakeup[0]);
+  close(reactor->wakeup[1]);
+  free(reactor);
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_add(VISCAReactor_t *reactor, VISCAInterface_t *iface, int *port)
+{
+  VISCAReactorPort_t *p;
+  int i;
+
+  if (iface->port_fd==-1)
+    return VISCA_FAILURE;
+  for (i=0;i<VISCA_REACTOR_MAX_PORTS;i++)
+    if (!reactor->ports[i].used)
+      break;
+  if (i==VISCA_REACTOR_MAX_PORTS)
+    return VISCA_FAILURE;
+
+  p=&reactor->ports[i];
+  memset(p, 0, sizeof(VISCAReactorPort_t));
+  p->iface=iface;
+  p->flags=fcntl(iface->port_fd, F_GETFL);
+  if (p->flags<0 || fcntl(iface->port_fd, F_SETFL, p->flags | O_NONBLOCK)<0)
+    return VISCA_FAILURE;
+  p->used=1;
+  *port=i;
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_remove(VISCAReactor_t *reactor, int port)
+{
+  VISCAReactorPort_t *p;
+
+  if (port<0 || port>=VISCA_REACTOR_MAX_PORTS || !reactor->ports[port].used)
+    return VISCA_FAILURE;
+  p=&reactor->ports[port];
+  _VISCA_reactor_fail_port(reactor, port);
+  p->used=0;
+  if (p->iface->port_fd!=-1)
+    fcntl(p->iface->port_fd, F_SETFL, p->flags);
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_port_alive(VISCAReactor_t *reactor, int port)
+{
+  if (port<0 || port>=VISCA_REACTOR_MAX_PORTS || !reactor->ports[port].used
+      || reactor->ports[port].dead)
+    return VISCA_FAILURE;
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_submit(VISCAReactor_t *reactor, int port, VISCACamera_t *camera,
+                     VISCAPacket_t *packet, VISCAReactorCallback_t callback, void *user)
+{
+  VISCAReactorPort_t *p;
+  VISCAReactorMsg_t *msg;
+
+  if (port<0 || port>=VISCA_REACTOR_MAX_PORTS || !reactor->ports[port].used)
+    return VISCA_FAILURE;
+  p=&reactor->ports[port];
+  if (p->dead || camera->address<1 || camera->address>7 || packet->length<2
+      || packet->length+1>sizeof(msg->bytes) || p->count==VISCA_REACTOR_QUEUE)
+    return VISCA_FAILURE;
+
+  msg=&p->queue[(p->head+p->count)%VISCA_REACTOR_QUEUE];
+  msg->callback=callback;
+  msg->user=user;
+  msg->camera=camera->address;
+  msg->inquiry=(packet->bytes[1]==VISCA_INQUIRY);
+  // same framing as _VISCA_send_packet, without touching the packet
+  memcpy(msg->bytes, packet->bytes, packet->length);
+  msg->bytes[0]=0x80 | (p->iface->address << 4) | camera->address;
+  msg->bytes[packet->length]=VISCA_TERMINATOR;
+  msg->length=packet->length+1;
+  p->count++;
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_run(VISCAReactor_t *reactor, uint32_t timeout_us)
+{
+  VISCAReactorPort_t *p;
+  uint64_t now, next;
+  unsigned char drain[64];
+  int i, n, port, wait_ms;
+
+  // send what can go now, and find the next deadline
+  now=_VISCA_reactor_now();
+  next= timeout_us ? now+timeout_us : UINT64_MAX;
+  reactor->pfd[0].fd=reactor->wakeup[0];
+  reactor->pfd[0].events=POLLIN;
+  n=1;
+  for (i=0;i<VISCA_REACTOR_MAX_PORTS;i++)
+    {
+      p=&reactor->ports[i];
+      if (!p->used || p->dead)
+        continue;
+      _VISCA_reactor_expire(reactor, i, now, &next);
+      if (!p->used || p->dead)
+        continue;
+      _VISCA_reactor_fill(p);
+      if (p->tx_len>0)
+        _VISCA_reactor_write(reactor, i);
+      if (!p->used || p->dead)
+        continue;
+      reactor->pfd[n].fd=p->iface->port_fd;
+      reactor->pfd[n].events=POLLIN | (p->tx_len>0 ? POLLOUT : 0);
+      reactor->pfd_port[n]=i;
+      n++;
+    }
+
+  if (next==UINT64_MAX)
+    wait_ms=-1;
+  else if (next<=now)
+    wait_ms=0;
+  else
+    wait_ms=(int)((next-now+999)/1000);
+  if (poll(reactor->pfd, n, wait_ms)<0)
+    return errno==EINTR ? VISCA_SUCCESS : VISCA_FAILURE;
+
+  if (reactor->pfd[0].revents & POLLIN)
+    while (read(reactor->wakeup[0], drain, sizeof(drain))>0)
+      ;
+  for (i=1;i<n;i++)
+    {
+      port=reactor->pfd_port[i];
+      p=&reactor->ports[port];
+      if (!p->used || p->dead)
+        continue;
+      if (reactor->pfd[i].revents & POLLIN)
+        _VISCA_reactor_read(reactor, port);
+      if (p->used && !p->dead && (reactor->pfd[i].revents & (POLLHUP | POLLERR | POLLNVAL)))
+        _VISCA_reactor_fail_port(reactor, port);
+      if (p->used && !p->dead && (reactor->pfd[i].revents & POLLOUT))
+        _VISCA_reactor_write(reactor, port);
+    }
+
+  // replies usually free a camera: send its next message right away
+  now=_VISCA_reactor_now();
+  for (i=0;i<VISCA_REACTOR_MAX_PORTS;i++)
+    {
+      p=&reactor->ports[i];
+      if (!p->used || p->dead)
+        continue;
+      next=UINT64_MAX;
+      _VISCA_reactor_expire(reactor, i, now, &next);
+      if (!p->used || p->dead)
+        continue;
+      _VISCA_reactor_fill(p);
+      if (p->tx_len>0)
+        _VISCA_reactor_write(reactor, i);
+    }
+  return VISCA_SUCCESS;
+}
+
+
+VISCA_API uint32_t
+VISCA_reactor_wakeup(VISCAReactor_t *reactor)
+{
+  unsigned char one=1;
+
+  if (write(reactor->wakeup[1], &one, 1)<0 && errno!=EAGAIN)
+    return VISCA_FAILURE;
+  return VISCA_SUCCESS;
+}
@@ -26,13 +26,6 @@
 #include <fcntl.h>
 #include <errno.h>
 
-/* implemented in libvisca.c
- */
-void _VISCA_append_byte(VISCAPacket_t *packet, unsigned char byte);
-void _VISCA_init_packet(VISCAPacket_t *packet);
-unsigned int _VISCA_get_reply(VISCAInterface_t *iface, VISCACamera_t *camera);
-unsigned int _VISCA_send_packet_with_reply(VISCAInterface_t *iface, VISCACamera_t *camera, VISCAPacket_t *packet);
-
 
 /* Implementation of the platform specific code. The following functions must
  * be implemented here:
@@ -229,6 +222,9 @@ VISCA_open_serial(VISCAInterface_t *iface, const char *device_name)
   // If all of these API's were successful then the port is ready for use.
   iface->port_fd = m_hCom;
   iface->address = 0;
+  iface->ack_mode = 0;
+  memset(iface->deferred, 0, sizeof(iface->deferred));
+  iface->done_head = iface->done_tail = 0;
 
   return VISCA_SUCCESS;
 }
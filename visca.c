@@ -8,59 +8,4526 @@
 #include "visca/libvisca.h"
 // libserialport must be built and installed
 #include <libserialport.h>
+// I/O thread
+#include <pthread.h>
+#include <math.h>
+#include <time.h>
+#ifndef _WIN32
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+static t_class *visca_class, *visca_tilde_class;
+
+// selectors used by the I/O thread (gensym is not thread safe)
+static t_symbol *s_track, *s_link, *s_latency, *s_error, *s_position, *s_expired, *s_zoom, *s_cue, *s_jitter, *s_raw;
+static t_symbol *s_focus_point;
+static t_symbol *s_completed, *s_done, *s_pantilt, *s_home, *s_reset, *s_preset, *s_focus;
+
+/* the link runs at 9600 8N1: 10 bits on the wire per byte */
+#define VISCA_LINK_BAUD 9600
+#define VISCA_BYTE_MS (10.0 * 1000.0 / VISCA_LINK_BAUD)
+
+/* I/O thread -> Pd thread messages, drained by a clock */
+#define VISCA_EVENT_ATOMS 16   // a whole VISCA reply fits
+#define VISCA_EVENT_QUEUE 64
+#define VISCA_POLL_MS 10
+
+/* commands queued for the I/O thread, one queue per priority class */
+#define VISCA_CMD_QUEUE 64
+#define VISCA_CMD_DRIVE 1   // pan/tilt drive, coalesced to the latest per camera
+#define VISCA_CMD_OTHER 0
+#define VISCA_CMD_PANTILT_POS 2   // pan/tilt position inquiry, reported as [position(
+#define VISCA_CMD_ZOOM_POS 3      // zoom position inquiry, reported as [zoom(
+#define VISCA_CMD_ZOOM 4          // zoom drive or direct position, coalesced per camera
+#define VISCA_CMD_FOCUS 5         // focus drive or direct position, coalesced per camera
+#define VISCA_CMD_PANTILT_ABS 6   // pan/tilt absolute position, coalesced per camera
+#define VISCA_CMD_CUE 7           // a cue from the owner's bank, fired as one write
+#define VISCA_CMD_RAW 8           // [raw( payload, the reply goes back as bytes
+#define VISCA_CMD_FOCUS_LEARN 9   // focus inquiry adding a point to the zoom->focus curve
+
+/* priority classes, highest first; a stop goes out before anything queued */
+#define VISCA_PRIO_SAFETY 0
+#define VISCA_PRIO_MOTION 1
+#define VISCA_PRIO_SETTINGS 2
+#define VISCA_PRIO_INQUIRY 3
+#define VISCA_PRIO_CLASSES 4
+
+/* timed commands: how many may wait, and how long before one is due the
+ * link is kept free so that nothing slow is in flight when it goes */
+#define VISCA_TIMED_QUEUE 32
+#define VISCA_AT_GUARD_MS 50
+#define VISCA_AT_SMOOTH 0.01   // how fast the logical->monotonic offset follows a rise
+
+/* inquiries older than this are stale and dropped unsent */
+#define VISCA_INQUIRY_DEADLINE_MS 500
+
+/* cameras share the link by deficit round-robin: each turn a camera may
+ * send weight * quantum bytes (command and expected replies) */
+#define VISCA_DRR_QUANTUM 32
+#define VISCA_REPLY_BYTES 6       // ACK + completion
+#define VISCA_INQ_REPLY_BYTES 11  // typical inquiry answer + slack
+
+/* link supervision: reconnect retry interval */
+#define VISCA_RECONNECT_MS 250
+
+/* session cache: ports remembered, and how long a known chain gets to
+ * answer the verification inquiry before the full handshake runs */
+#define VISCA_SESSIONS 16
+#define VISCA_VERIFY_MS 200
+
+/* a camera runs one command per socket and has two */
+#define VISCA_SOCKETS 2
+
+/* a pan/tilt move whose completion is overdue: ask the pan/tilt status
+ * this long after the ACK and again as long as it reads "moving" */
+#define VISCA_DONE_CHECK_MS 1000
+#define VISCA_PT_STATUS(mode) (((mode) >> 2) & 0x03)
+#define VISCA_PT_STATUS_MOVING 1
+#define VISCA_PT_STATUS_FAILED 3
+
+/* cue banks: frames per cue, the longest frame a cue line compiles to, and
+ * how long a camera may stay silent before a running cue gives up on it */
+#define VISCA_CUE_FRAMES 64
+#define VISCA_CUE_FRAME_BYTES 16
+#define VISCA_CUE_TIMEOUT_MS 10000
+
+/* pan/tilt/zoom drive speed indices (D30/D70) */
+#define VISCA_PAN_SPEED_MAX 24
+#define VISCA_TILT_SPEED_MAX 20
+#define VISCA_ZOOM_SPEED_MAX 7
+
+/* position estimate: axes, zoom range and the slow poll while nothing moves */
+#define VISCA_AXIS_PAN 0
+#define VISCA_AXIS_TILT 1
+#define VISCA_AXIS_ZOOM 2
+#define VISCA_AXES 3
+#define VISCA_ZOOM_MAX 0x4000
+#define VISCA_ESTIMATE_IDLE_POLLS 10
+
+/* zoom to horizontal field of view: degrees at this many zoom positions
+ * spread evenly over 0..VISCA_ZOOM_MAX */
+#define VISCA_FOV_POINTS 9
+
+/* zoom->focus tracking curve: points per camera, and how close two zoom
+ * positions may be before a learned point replaces the old one */
+#define VISCA_FOCUS_POINTS 16
+#define VISCA_FOCUS_MERGE 64
+
+/* follow mode: step period (a video frame at 25 fps), how many periods a
+ * slave takes to close a gap, and the error an axis may keep */
+#define VISCA_FOLLOW_MS 40
+#define VISCA_FOLLOW_CATCHUP 4
+#define VISCA_FOLLOW_DEADBAND 2
+#define VISCA_FOLLOW_ZOOM_DEADBAND 32
+#define VISCA_RTT_GAIN 0.1   // how fast the smoothed round trip follows a sample
+
+/* look-at: a world point older than this means the tracker has stopped and
+ * the cameras park on it */
+#define VISCA_LOOK_HOLD_MS 250
+
+/* [visca~]: pan, tilt, zoom and focus inlets, sent as three commands */
+#define VISCA_SIG_CHANNELS 4
+#define VISCA_SIG_PANTILT 0
+#define VISCA_SIG_ZOOM 1
+#define VISCA_SIG_FOCUS 2
+#define VISCA_SIG_GROUPS 3
+#define VISCA_SIG_INTERVAL_MS 50
+#define VISCA_FOCUS_SPEED_MAX 7
+
+/* a daisy chain holds up to 7 cameras; objects sharing one connection */
+#define VISCA_MAX_CAMERAS 7
+#define VISCA_CONN_CLIENTS 32
+
+/* port names, as given and with links resolved: a whole path fits */
+#ifdef PATH_MAX
+#define VISCA_PATH_MAX PATH_MAX
+#else
+#define VISCA_PATH_MAX MAXPDSTRING
+#endif
+
+typedef struct _visca_event {
+	t_symbol *sel;
+	int argc;
+	t_atom argv[VISCA_EVENT_ATOMS];
+} t_visca_event;
+
+struct _visca;
+
+typedef struct _visca_cmd {
+	int kind;
+	int prio;
+	double deadline;        // drop unsent after this (ms, 0 never)
+	double queued;          // when it was submitted (ms)
+	struct _visca *owner;   // replies go to the object that asked
+	int camera;
+	VISCAPacket_t packet;
+	int cue;                // VISCA_CMD_CUE: index into the owner's bank
+	double at;              // release at this CLOCK_MONOTONIC ms, 0 when queued
+	double sent;            // when its frame was written (ms)
+} t_visca_cmd;
+
+/* a command returned at its ACK, until its completion comes in */
+typedef struct _visca_running {
+	int on;
+	t_visca_cmd cmd;
+	double acked;           // when it was ACKed (ms)
+	double checked;         // when the pan/tilt status was last asked
+} t_visca_running;
+
+typedef struct _visca_queue {
+	t_visca_cmd cmds[VISCA_CMD_QUEUE];
+	int head, tail;
+} t_visca_queue;
+
+/* per camera share of the link and what it got */
+typedef struct _visca_share {
+	float weight;
+	float deficit[VISCA_PRIO_CLASSES];   // bytes left this turn
+	unsigned int sent, expired;
+	double bytes;
+	double wait_sum, wait_max;           // queueing delay of sent commands (ms)
+} t_visca_share;
+
+/* A cue bank: every frame of every cue assembled at load time, header to
+ * terminator. A cue's frames are stored so that its first wave (as many
+ * frames per camera as it has command sockets) is one run of bytes.
+ */
+typedef struct _visca_frame {
+	int camera;
+	int offset;   // into the bank's bytes
+	int length;
+} t_visca_frame;
+
+typedef struct _visca_cue {
+	t_symbol *name;
+	int first;          // into the bank's frames
+	int nframes;
+	int wave;           // frames in the first write
+	int wave_bytes;
+	int bytes;          // all frames
+} t_visca_cue;
+
+typedef struct _visca_bank {
+	t_visca_cue *cues;
+	int ncues;
+	t_visca_frame *frames;
+	int nframes;
+	unsigned char *bytes;
+	int nbytes;
+} t_visca_bank;
+
+/* host side auto-tracking controller (PID on the AT object position) */
+typedef struct _visca_track {
+	int on;
+	float kp, ki, kd;
+	float rate;        // requested loop rate in Hz
+	float budget;      // fraction of the link the loop may use
+	float center_x, center_y;
+	float range_x, range_y;
+	float deadband;    // normalised error below which an axis stops
+	float int_x, int_y;
+	float err_x, err_y;
+	int acquired;      // err_x/err_y hold a sample of the current target
+	int pan_dir, tilt_dir;
+	int pan_speed, tilt_speed;
+	double next;       // when the I/O thread runs the next step
+} t_visca_track;
+
+/* host side follow mode: this object's camera copies the pose of another
+ * camera on the same chain */
+typedef struct _visca_follow {
+	int master;        // camera address followed, 0 off
+	float offset[VISCA_AXES];   // added to the master's pose
+	int mirror;        // pan turns the other way round
+	int pan_dir, tilt_dir, zoom_dir;   // drive last sent, as for visca_drive_packet()
+	int pan_speed, tilt_speed, zoom_speed;
+	int settled;       // parked on the master's resting pose
+	double next;       // when the I/O thread runs the next step
+	double next_poll;  // when the master's position is asked next
+} t_visca_follow;
+
+/* dead-reckoned head position: the last polled or rebased position plus
+ * the commanded velocity, looked up in per camera speed tables */
+typedef struct _visca_estimate {
+	double stamp;        // ms, when pos was taken
+	float pos[VISCA_AXES];
+	float vel[VISCA_AXES];   // units per second
+	int known;           // axes polled since the link came up, one bit each
+	float pan_speeds[VISCA_PAN_SPEED_MAX + 1];   // units per second by speed index
+	float tilt_speeds[VISCA_TILT_SPEED_MAX + 1];
+	float zoom_speeds[VISCA_ZOOM_SPEED_MAX + 1];
+	float units_per_degree[2];   // pan, tilt
+	float fov[VISCA_FOV_POINTS];
+	float focus_zoom[VISCA_FOCUS_POINTS];   // zoom->focus curve, by rising zoom
+	float focus_value[VISCA_FOCUS_POINTS];
+	int nfocus;
+} t_visca_estimate;
+
+/* look-at: where a camera is mounted in world coordinates, and the aim the
+ * I/O thread last derived for it from a world point */
+typedef struct _visca_aim {
+	int mounted;
+	float origin[3];      // world position of the pan/tilt centre
+	float axes[3][3];     // the mount's forward, left and up in world coordinates
+	float target[VISCA_AXES];   // pan/tilt/zoom for the last point
+	float rate[VISCA_AXES];     // its change per second between points
+	double interval;      // ms between the last two points, 0 for a first one
+	int zoom;             // frame the point: zoom follows too
+	double stamp;         // when the last point came in, 0 none
+	int sent[VISCA_AXES]; // signed speed index last queued
+	int settled;          // parked on a point that stopped moving
+} t_visca_aim;
+
+/* look-at: the latest world point, picked up by the I/O thread */
+typedef struct _visca_look {
+	struct _visca *owner; // the object replies go to, 0 off
+	float point[3];
+	float width;          // world units across the frame at the point, 0 no zoom
+	int fresh;            // not aimed at yet
+	double stamp;         // when it came in
+	double next;          // when the I/O thread runs the next step
+} t_visca_look;
+
+/* One serial port (daisy chain) and the I/O thread serving it, shared by
+ * every [visca] object opened on the same port or name.
+ */
+typedef struct _visca_conn {
+	t_symbol *port;    // registry keys: the device and an optional alias
+	t_symbol *alias;
+	int refcount;
+	struct _visca_conn *next;
+	/*Structures needed for the VISCA library*/
+	VISCAInterface_t iface;
+	VISCACamera_t cameras[VISCA_MAX_CAMERAS + 1];   // by address, info cached at handshake
+	int ncameras;
+	/*I/O thread*/
+	pthread_mutex_t iface_lock;
+	pthread_mutex_t client_lock;   // held by the thread while it works for a client, but for wire waits
+	pthread_mutex_t io_lock;
+	struct sp_event_set *io_events;   // hotplug + wakeup, waited on by the I/O thread
+	pthread_t io_thread;
+	int io_running;
+	int io_quit;
+	t_visca_queue queues[VISCA_PRIO_CLASSES];
+	t_visca_cmd timed[VISCA_TIMED_QUEUE];   // held back until their instant
+	int ntimed;
+	t_visca_share shares[VISCA_MAX_CAMERAS + 1];
+	int drr_cur[VISCA_PRIO_CLASSES];     // camera whose turn it is
+	int drr_fresh[VISCA_PRIO_CLASSES];   // its quantum is still to be added
+	t_visca_estimate estimates[VISCA_MAX_CAMERAS + 1];
+	/*ACK-return mode: motion commands running, by camera and socket*/
+	int ack_return;
+	t_visca_running running[VISCA_MAX_CAMERAS + 1][VISCA_SOCKETS + 1];
+	int nrunning;
+	double rtt;        // ms, inquiry round trip smoothed by VISCA_RTT_GAIN
+	/*look-at: mounting poses by camera address, and the point they aim at*/
+	t_visca_aim aims[VISCA_MAX_CAMERAS + 1];
+	t_visca_look look;
+	struct _visca *clients[VISCA_CONN_CLIENTS];
+	int nclients;
+	/*link supervision*/
+	char port_name[VISCA_PATH_MAX];
+	char kernel_name[VISCA_PATH_MAX];   // port_name with links resolved, as hotplug events name it
+	char usb_serial[128];
+	int link_up;
+	double link_lost_ms;
+	struct sp_hotplug *hotplug;
+	int resumed;       // the last handshake was a verified cached session
+	/*low latency mode: a second handle holds the driver settings*/
+	int low_latency;
+	int latency_tried;
+	struct sp_port *latency_port;
+} t_visca_conn;
+
+typedef struct _visca {
+	t_object x_obj;
+	t_outlet *bang_out;
+	t_outlet *float_out;
+	t_outlet *data_out;
+	/*shared connection and the camera this object talks to*/
+	t_visca_conn *conn;
+	int address;
+	int low_latency;
+	int ack_return;
+	int focus_track;  // direct zoom positions carry the focus from the curve
+	float fov_rate;   // [drive_fov(: frame widths per second at full deflection
+	float deadline;   // inquiry deadline in ms
+	double at;        // while [at( dispatches: when its command is released
+	double at_ref;    // logical time [at( delays count from
+	double at_offset; // CLOCK_MONOTONIC ms minus logical ms since at_ref
+	t_canvas *canvas;
+	t_visca_bank *bank;   // read by the I/O thread under conn->client_lock
+	/*I/O thread -> Pd messages*/
+	pthread_mutex_t event_lock;
+	t_visca_event events[VISCA_EVENT_QUEUE];
+	int event_head, event_tail;
+	t_clock *poll_clock;
+	t_clock *devices_clock;
+	t_visca_track track;   // guarded by conn->io_lock while connected
+	t_visca_follow follow; // likewise
+	/*position estimate output and polling*/
+	t_clock *estimate_clock;
+	float estimate_ms;
+	float estimate_poll;
+	double next_poll;
+	/*[visca~]: signal inlets decimated to what the link carries*/
+	t_float sig_f;
+	int sig_absolute;              // position targets instead of speeds
+	int sig_channels;              // enabled inlets, one bit each
+	float sig_in[VISCA_SIG_CHANNELS];     // last sample of the latest block
+	float sig_sent[VISCA_SIG_CHANNELS];   // value (or speed index) last queued
+	double sig_stamp[VISCA_SIG_GROUPS];   // logical time each command last went out
+	float sig_interval;
+	float sig_deadband;
+	int sig_pending;
+	t_clock *sig_clock;
+} t_visca;
+
+// connections by port and alias (Pd thread only)
+static t_visca_conn *visca_conns;
+
+
+/*-------------------------------------------*/
+// Print Object usage
+/*-------------------------------------------*/
+void visca_print_usage_bang() {
+	post("Usage: visca-cli [-d <serial port device>] command\n");
+	post("  default serial port device: \n");      
+	post("  for available commands see sourcecode...\n"); 
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Print Object info
+/*-------------------------------------------*/
+void visca_info(){
+	post("This object written to control PTZ cameras using Visca protocol. \n"
+		"Supports Sony D70/D30.\n"
+		"megrimm 2019\n");
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// I/O Thread
+/*-------------------------------------------*/
+/* Blocking libvisca calls run on one worker thread per connection so the Pd
+ * scheduler never waits on the serial line. The thread owns the interface
+ * while it runs; anything else touching conn->iface must hold iface_lock.
+ * Results come back to each object through a small event queue that a
+ * clock drains.
+ */
+
+/* AT position status reported by the D30/D70 */
+#define VISCA_AT_STATUS_TRACKING 1
+
+/* wire cost of one tracking iteration in bytes:
+ * AT position inquiry (5) + reply (6), drive command (9) + ACK (3) + completion (3) */
+#define VISCA_TRACK_INQ_BYTES 11
+#define VISCA_TRACK_DRIVE_BYTES 15
+
+static double visca_now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// queue a message for the Pd thread (floats only), dropped when the queue is
+// full or when the command has no owner left
+static void visca_post_event(t_visca *x, t_symbol *sel, int argc, const float *argv) {
+	int i, next;
+	if (!x)
+		return;
+	pthread_mutex_lock(&x->event_lock);
+	next = (x->event_tail + 1) % VISCA_EVENT_QUEUE;
+	if (next != x->event_head) {
+		t_visca_event *e = &x->events[x->event_tail];
+		e->sel = sel;
+		e->argc = argc > VISCA_EVENT_ATOMS ? VISCA_EVENT_ATOMS : argc;
+		for (i = 0; i < e->argc; i++)
+			SETFLOAT(&e->argv[i], argv[i]);
+		x->event_tail = next;
+	}
+	pthread_mutex_unlock(&x->event_lock);
+}
+
+// the same with a symbol first (made by gensym() beforehand)
+static void visca_post_event_sym(t_visca *x, t_symbol *sel, t_symbol *s, int argc, const float *argv) {
+	int i, next;
+	if (!x)
+		return;
+	pthread_mutex_lock(&x->event_lock);
+	next = (x->event_tail + 1) % VISCA_EVENT_QUEUE;
+	if (next != x->event_head) {
+		t_visca_event *e = &x->events[x->event_tail];
+		e->sel = sel;
+		e->argc = argc + 1 > VISCA_EVENT_ATOMS ? VISCA_EVENT_ATOMS : argc + 1;
+		SETSYMBOL(&e->argv[0], s);
+		for (i = 1; i < e->argc; i++)
+			SETFLOAT(&e->argv[i], argv[i - 1]);
+		x->event_tail = next;
+	}
+	pthread_mutex_unlock(&x->event_lock);
+}
+
+// is the object still attached? (caller holds client_lock or io_lock)
+static int visca_conn_has(const t_visca_conn *c, const t_visca *x) {
+	int i;
+	for (i = 0; i < c->nclients; i++)
+		if (c->clients[i] == x)
+			return 1;
+	return 0;
+}
+
+// a wire transaction: client_lock is let go while the thread waits on the
+// camera, so Pd methods needing it are never kept out for long. Objects
+// may detach meanwhile: anything the caller held about one must be looked
+// up again with visca_conn_has() after visca_wire_unlock().
+static void visca_wire_lock(t_visca_conn *c) {
+	pthread_mutex_unlock(&c->client_lock);
+	pthread_mutex_lock(&c->iface_lock);
+}
+
+static void visca_wire_unlock(t_visca_conn *c) {
+	pthread_mutex_unlock(&c->iface_lock);
+	pthread_mutex_lock(&c->client_lock);
+}
+
+// the same message to every object on the connection
+static void visca_conn_broadcast(t_visca_conn *c, t_symbol *sel, int argc, const float *argv) {
+	int i;
+	pthread_mutex_lock(&c->io_lock);
+	for (i = 0; i < c->nclients; i++)
+		visca_post_event(c->clients[i], sel, argc, argv);
+	pthread_mutex_unlock(&c->io_lock);
+}
+
+// clock callback: forward queued events to the data outlet
+static void visca_poll_tick(t_visca *x) {
+	t_visca_event e;
+	for (;;) {
+		pthread_mutex_lock(&x->event_lock);
+		if (x->event_head == x->event_tail) {
+			pthread_mutex_unlock(&x->event_lock);
+			break;
+		}
+		e = x->events[x->event_head];
+		x->event_head = (x->event_head + 1) % VISCA_EVENT_QUEUE;
+		pthread_mutex_unlock(&x->event_lock);
+		outlet_anything(x->data_out, e.sel, e.argc, e.argv);
+	}
+	if (x->conn)
+		clock_delay(x->poll_clock, VISCA_POLL_MS);
+}
+
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Position Estimate
+/*-------------------------------------------*/
+/* Position inquiries cost a round trip each, so between polls the head
+ * position is dead-reckoned from the drive commands the I/O thread sent
+ * and the speed tables. Every poll result resets the estimate. All of it
+ * is guarded by io_lock.
+ */
+
+// nominal EVI-D70 speeds (pan 1.7-100 deg/s, tilt 1.7-90 deg/s at 0.075 deg
+// per unit; full zoom travel in 8 s at speed 0 down to 2 s at speed 7);
+// [speed_table( and [profile( replace them with measured ones
+static void visca_estimate_init(t_visca_estimate *e) {
+	int i;
+	memset(e, 0, sizeof(*e));
+	for (i = 1; i <= VISCA_PAN_SPEED_MAX; i++)
+		e->pan_speeds[i] = (1.7 + 98.3 * (i - 1) / (VISCA_PAN_SPEED_MAX - 1)) / 0.075;
+	for (i = 1; i <= VISCA_TILT_SPEED_MAX; i++)
+		e->tilt_speeds[i] = (1.7 + 88.3 * (i - 1) / (VISCA_TILT_SPEED_MAX - 1)) / 0.075;
+	for (i = 0; i <= VISCA_ZOOM_SPEED_MAX; i++)
+		e->zoom_speeds[i] = VISCA_ZOOM_MAX / (8.0 - 6.0 * i / VISCA_ZOOM_SPEED_MAX);
+	e->units_per_degree[VISCA_AXIS_PAN] = e->units_per_degree[VISCA_AXIS_TILT] = 1 / 0.075;
+	// 48.8 deg wide to 2.7 deg tele, the focal length taken as exponential in the zoom position
+	for (i = 0; i < VISCA_FOV_POINTS; i++)
+		e->fov[i] = 48.8 * pow(2.7 / 48.8, (double)i / (VISCA_FOV_POINTS - 1));
+}
+
+// horizontal field of view in degrees at a zoom position
+static float visca_estimate_fov(const t_visca_estimate *e, float zoom) {
+	float x = zoom / VISCA_ZOOM_MAX * (VISCA_FOV_POINTS - 1);
+	int i = (int)x;
+	if (i < 0)
+		return e->fov[0];
+	if (i >= VISCA_FOV_POINTS - 1)
+		return e->fov[VISCA_FOV_POINTS - 1];
+	return e->fov[i] + (e->fov[i + 1] - e->fov[i]) * (x - i);
+}
+
+// zoom position giving a horizontal field of view, the inverse of
+// visca_estimate_fov(); held at the ends of the table
+static float visca_estimate_fov_zoom(const t_visca_estimate *e, float fov) {
+	int i;
+	if (fov >= e->fov[0])
+		return 0;
+	for (i = 1; i < VISCA_FOV_POINTS; i++)
+		if (fov >= e->fov[i])
+			return (i - 1 + (e->fov[i - 1] - fov) / (e->fov[i - 1] - e->fov[i]))
+				* VISCA_ZOOM_MAX / (VISCA_FOV_POINTS - 1);
+	return VISCA_ZOOM_MAX;
+}
+
+// focus for a zoom position from the curve, held flat past its ends; -1
+// without a curve
+static int visca_estimate_focus(const t_visca_estimate *e, float zoom) {
+	int i;
+	if (!e->nfocus)
+		return -1;
+	if (zoom <= e->focus_zoom[0])
+		return (int)lrintf(e->focus_value[0]);
+	for (i = 1; i < e->nfocus; i++)
+		if (zoom <= e->focus_zoom[i])
+			return (int)lrintf(e->focus_value[i - 1] + (e->focus_value[i] - e->focus_value[i - 1])
+				* (zoom - e->focus_zoom[i - 1]) / (e->focus_zoom[i] - e->focus_zoom[i - 1]));
+	return (int)lrintf(e->focus_value[e->nfocus - 1]);
+}
+
+// add a curve point in zoom order; one close to an old point replaces it,
+// a full curve drops the new one
+static void visca_estimate_focus_point(t_visca_estimate *e, float zoom, float focus) {
+	int i, j;
+	for (i = 0; i < e->nfocus && e->focus_zoom[i] < zoom - VISCA_FOCUS_MERGE; i++)
+		;
+	if (i < e->nfocus && fabsf(e->focus_zoom[i] - zoom) <= VISCA_FOCUS_MERGE) {
+		e->focus_zoom[i] = zoom;
+		e->focus_value[i] = focus;
+		return;
+	}
+	if (e->nfocus == VISCA_FOCUS_POINTS)
+		return;
+	for (j = e->nfocus++; j > i; j--) {
+		e->focus_zoom[j] = e->focus_zoom[j - 1];
+		e->focus_value[j] = e->focus_value[j - 1];
+	}
+	e->focus_zoom[i] = zoom;
+	e->focus_value[i] = focus;
+}
+
+// the speed index (1..max) whose table speed is nearest to units per second
+static int visca_speed_index(const float *speeds, int max, float units) {
+	int i, best = 1;
+	for (i = 2; i <= max; i++)
+		if (fabsf(speeds[i] - units) < fabsf(speeds[best] - units))
+			best = i;
+	return best;
+}
+
+// speed indices for a move of dpan, dtilt units taking ms (0: as fast as
+// the max indices allow); returns the travel time in ms (caller holds io_lock)
+static double visca_plan_move(const t_visca_estimate *e, float dpan, float dtilt, double ms,
+	int max_pan, int max_tilt, int *pan_speed, int *tilt_speed) {
+	double tp, tt, arrival, cost, best = -1, best_arrival = 0;
+	int i, j;
+	dpan = fabsf(dpan);
+	dtilt = fabsf(dtilt);
+	*pan_speed = max_pan;
+	*tilt_speed = max_tilt;
+	if (ms <= 0)
+		ms = fmax(dpan / e->pan_speeds[max_pan], dtilt / e->tilt_speeds[max_tilt]) * 1000.0;
+	for (i = 1; i <= max_pan; i++)
+		for (j = 1; j <= max_tilt; j++) {
+			tp = dpan / e->pan_speeds[i] * 1000.0;
+			tt = dtilt / e->tilt_speeds[j] * 1000.0;
+			arrival = fmax(tp, tt);
+			// an axis that does not move arrives whenever the other does
+			cost = (dpan > 0 && dtilt > 0 ? fabs(tp - tt) : 0) + fabs(arrival - ms);
+			if (best < 0 || cost < best || (cost == best && arrival < best_arrival)) {
+				best = cost;
+				best_arrival = arrival;
+				*pan_speed = i;
+				*tilt_speed = j;
+			}
+		}
+	return best_arrival;
+}
+
+// predicted position of every axis at time now
+static void visca_estimate_at(const t_visca_estimate *e, double now, float *pos) {
+	int i;
+	for (i = 0; i < VISCA_AXES; i++)
+		pos[i] = e->pos[i] + e->vel[i] * (now - e->stamp) / 1000.0;
+	if (pos[VISCA_AXIS_ZOOM] < 0) pos[VISCA_AXIS_ZOOM] = 0;
+	if (pos[VISCA_AXIS_ZOOM] > VISCA_ZOOM_MAX) pos[VISCA_AXIS_ZOOM] = VISCA_ZOOM_MAX;
+}
+
+// move the reference point to now before changing a velocity or position
+static void visca_estimate_rebase(t_visca_estimate *e, double now) {
+	visca_estimate_at(e, now, e->pos);
+	e->stamp = now;
+}
+
+// a pan/tilt drive went out: directions as for visca_drive_packet()
+static void visca_estimate_pantilt(t_visca_estimate *e, double now, int pan_dir, int tilt_dir, int pan_speed, int tilt_speed) {
+	if (pan_speed > VISCA_PAN_SPEED_MAX) pan_speed = VISCA_PAN_SPEED_MAX;
+	if (tilt_speed > VISCA_TILT_SPEED_MAX) tilt_speed = VISCA_TILT_SPEED_MAX;
+	visca_estimate_rebase(e, now);
+	e->vel[VISCA_AXIS_PAN] = pan_dir * e->pan_speeds[pan_speed];
+	e->vel[VISCA_AXIS_TILT] = -tilt_dir * e->tilt_speeds[tilt_speed];
+}
+
+// a command completed: pick up drives that change the velocity
+static void visca_estimate_command(t_visca_estimate *e, double now, const VISCAPacket_t *packet) {
+	const unsigned char *b = packet->bytes + 1;
+	if (b[0] != VISCA_COMMAND)
+		return;
+	if (b[1] == VISCA_CATEGORY_PAN_TILTER && b[2] == VISCA_PT_DRIVE) {
+		visca_estimate_pantilt(e, now,
+			b[5] == VISCA_PT_DRIVE_HORIZ_LEFT ? -1 : b[5] == VISCA_PT_DRIVE_HORIZ_RIGHT,
+			b[6] == VISCA_PT_DRIVE_VERT_UP ? -1 : b[6] == VISCA_PT_DRIVE_VERT_DOWN,
+			b[3], b[4]);
+	} else if (b[1] == VISCA_CATEGORY_CAMERA1 && b[2] == VISCA_ZOOM) {
+		visca_estimate_rebase(e, now);
+		if ((b[3] & 0xF0) == VISCA_ZOOM_TELE_SPEED)
+			e->vel[VISCA_AXIS_ZOOM] = e->zoom_speeds[b[3] & 0x07];
+		else if ((b[3] & 0xF0) == VISCA_ZOOM_WIDE_SPEED)
+			e->vel[VISCA_AXIS_ZOOM] = -e->zoom_speeds[b[3] & 0x07];
+		else
+			e->vel[VISCA_AXIS_ZOOM] = 0;
+	}
+}
+
+// a poll result replaces the prediction for that axis
+static void visca_estimate_fix(t_visca_estimate *e, double now, int axis, float value) {
+	visca_estimate_rebase(e, now);
+	e->pos[axis] = value;
+	e->known |= 1 << axis;
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Link Supervision
+/*-------------------------------------------*/
+/* USB serial adapters re-enumerate when they are unplugged or reset. The
+ * I/O thread watches libserialport hotplug events (or, where those are not
+ * supported, notices I/O errors and rescans), finds the adapter again by
+ * its USB serial number, redoes the handshake and then replays whatever
+ * the patch queued while the link was down.
+ */
+
+// after a failed transfer: is the device still there? (caller holds iface_lock)
+static int visca_port_alive(t_visca_conn *c) {
+#ifdef VISCA_POSIX
+	struct pollfd pfd;
+	int bytes;
+	if (c->iface.port_fd == -1)
+		return 0;
+	pfd.fd = c->iface.port_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) < 0 || (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+		return 0;
+	return ioctl(c->iface.port_fd, FIONREAD, &bytes) >= 0;
+#else
+	return 1;
+#endif
+}
+
+// address/clear/info exchange for the whole chain; returns 0 or a
+// description of the failed step (caller holds iface_lock)
+static const char *visca_handshake_full(t_visca_conn *c) {
+	int camera_num, i;
+	c->iface.broadcast = 0;
+	// the first address reply after power-up can be stale, ask twice
+	VISCA_set_address(&c->iface, &camera_num);
+	if (VISCA_set_address(&c->iface, &camera_num) != VISCA_SUCCESS)
+		return "unable to set address";
+	// an echoed broadcast with no camera behind it counts nobody
+	if (camera_num < 1 || camera_num > VISCA_MAX_CAMERAS)
+		return "no camera answered the address broadcast";
+	c->ncameras = camera_num;
+	for (i = 1; i <= VISCA_MAX_CAMERAS; i++)
+		c->cameras[i].address = i;
+	for (i = 1; i <= camera_num; i++) {
+		if (VISCA_clear(&c->iface, &c->cameras[i]) != VISCA_SUCCESS)
+			return "unable to clear interface";
+		if (VISCA_get_camera_info(&c->iface, &c->cameras[i]) != VISCA_SUCCESS)
+			return "unable to oget camera infos";
+	}
+	return 0;
+}
+
+/* Session cache: the chain found by the last full handshake on each
+ * adapter, by USB serial number (or device name when it has none). It
+ * lives as long as Pd does, and in the file given to [session_file( when
+ * there is one. Reopening a known adapter asks its last camera for its
+ * version once; if that camera answers as before, the cached addresses
+ * and camera info are used and the address/clear/info exchange is skipped.
+ * A camera added to the end of the chain is not noticed this way:
+ * [session_forget( forces the full handshake.
+ */
+typedef struct _visca_session {
+	char key[VISCA_PATH_MAX];
+	int ncameras;
+	VISCACamera_t cameras[VISCA_MAX_CAMERAS + 1];
+} t_visca_session;
+
+// shared by the Pd thread and every I/O thread
+static pthread_mutex_t visca_session_lock = PTHREAD_MUTEX_INITIALIZER;
+static t_visca_session visca_sessions[VISCA_SESSIONS];
+static int visca_nsessions;
+static char visca_session_path[MAXPDSTRING];
+
+static const char *visca_session_key(t_visca_conn *c) {
+	return c->usb_serial[0] ? c->usb_serial : c->port_name;
+}
+
+// caller holds visca_session_lock
+static t_visca_session *visca_session_find(const char *key) {
+	int i;
+	for (i = 0; i < visca_nsessions; i++)
+		if (!strcmp(visca_sessions[i].key, key))
+			return &visca_sessions[i];
+	return 0;
+}
+
+// rewrite the session file (caller holds visca_session_lock)
+static void visca_session_save(void) {
+	FILE *fp;
+	int i, j;
+	VISCACamera_t *cam;
+	if (!visca_session_path[0] || !(fp = fopen(visca_session_path, "w")))
+		return;
+	for (i = 0; i < visca_nsessions; i++) {
+		// the key is length-prefixed: device paths may hold spaces
+		fprintf(fp, "%u:%s %d", (unsigned)strlen(visca_sessions[i].key),
+			visca_sessions[i].key, visca_sessions[i].ncameras);
+		for (j = 1; j <= visca_sessions[i].ncameras; j++) {
+			cam = &visca_sessions[i].cameras[j];
+			fprintf(fp, " %x %x %x %x", (unsigned)cam->vendor, (unsigned)cam->model,
+				(unsigned)cam->rom_version, (unsigned)cam->socket_num);
+		}
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+// merge the session file into the cache (caller holds visca_session_lock)
+static void visca_session_load(void) {
+	t_visca_session s, *slot;
+	unsigned v[4], len;
+	char line[VISCA_PATH_MAX + 256];
+	FILE *fp;
+	int j, pos, used;
+	if (!visca_session_path[0] || !(fp = fopen(visca_session_path, "r")))
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		memset(&s, 0, sizeof(s));
+		pos = -1;
+		if (sscanf(line, "%u:%n", &len, &pos) != 1 || pos < 0
+			|| len >= sizeof(s.key) || len > strlen(line + pos))
+			continue;
+		memcpy(s.key, line + pos, len);
+		pos += len;
+		if (sscanf(line + pos, " %d%n", &s.ncameras, &used) != 1
+			|| s.ncameras < 1 || s.ncameras > VISCA_MAX_CAMERAS)
+			continue;
+		pos += used;
+		for (j = 1; j <= s.ncameras; j++) {
+			if (sscanf(line + pos, "%x %x %x %x%n", &v[0], &v[1], &v[2], &v[3], &used) != 4)
+				break;
+			pos += used;
+			s.cameras[j].address = j;
+			s.cameras[j].vendor = v[0];
+			s.cameras[j].model = v[1];
+			s.cameras[j].rom_version = v[2];
+			s.cameras[j].socket_num = v[3];
+		}
+		if (j <= s.ncameras)
+			continue;
+		if (!(slot = visca_session_find(s.key))) {
+			if (visca_nsessions == VISCA_SESSIONS)
+				break;
+			slot = &visca_sessions[visca_nsessions++];
+		}
+		*slot = s;
+	}
+	fclose(fp);
+}
+
+// remember what the full handshake found
+static void visca_session_store(t_visca_conn *c) {
+	const char *key = visca_session_key(c);
+	t_visca_session *s;
+	// a key that does not fit is not cached rather than cut short, where
+	// it could match another adapter's
+	if (strlen(key) >= sizeof(s->key))
+		return;
+	pthread_mutex_lock(&visca_session_lock);
+	if (!(s = visca_session_find(key))) {
+		// full: the oldest entry makes room
+		if (visca_nsessions == VISCA_SESSIONS)
+			memmove(&visca_sessions[0], &visca_sessions[1],
+				--visca_nsessions * sizeof(t_visca_session));
+		s = &visca_sessions[visca_nsessions++];
+	}
+	strcpy(s->key, key);
+	s->ncameras = c->ncameras;
+	memcpy(s->cameras, c->cameras, sizeof(s->cameras));
+	visca_session_save();
+	pthread_mutex_unlock(&visca_session_lock);
+}
+
+// ask the last camera of a cached chain for its version, waiting at most
+// VISCA_VERIFY_MS; 1 if it is the camera we knew (caller holds iface_lock)
+static int visca_session_verify(t_visca_conn *c, const t_visca_session *s) {
+#ifdef VISCA_POSIX
+	VISCACamera_t probe = s->cameras[s->ncameras];
+	VISCAPacket_t packet;
+	struct pollfd pfd;
+	double until = visca_now_ms() + VISCA_VERIFY_MS;
+	int bytes = 0, left;
+
+	c->iface.broadcast = 0;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_INQUIRY);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_INTERFACE);
+	_VISCA_append_byte(&packet, 0x02);
+	if (_VISCA_send_packet(&c->iface, &probe, &packet) != VISCA_SUCCESS)
+		return 0;
+	// the version reply is 10 bytes: wait for all of it without blocking
+	// on a chain that does not answer any more
+	pfd.fd = c->iface.port_fd;
+	pfd.events = POLLIN;
+	while (ioctl(c->iface.port_fd, FIONREAD, &bytes) >= 0 && bytes < 10) {
+		left = (int)(until - visca_now_ms());
+		if (left <= 0 || poll(&pfd, 1, left) < 0 || (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+			break;
+	}
+	if (bytes < 10) {
+		tcflush(c->iface.port_fd, TCIFLUSH);
+		return 0;
+	}
+	if (_VISCA_get_reply(&c->iface, &probe) != VISCA_SUCCESS || c->iface.bytes != 10
+		|| c->iface.ibuf[0] != (0x80 | (probe.address << 4)))
+		return 0;
+	return ((c->iface.ibuf[2] << 8) + c->iface.ibuf[3]) == (int)probe.vendor
+		&& ((c->iface.ibuf[4] << 8) + c->iface.ibuf[5]) == (int)probe.model
+		&& ((c->iface.ibuf[6] << 8) + c->iface.ibuf[7]) == (int)probe.rom_version;
+#else
+	return 0;
+#endif
+}
+
+// take the cached chain if it still answers (caller holds iface_lock)
+static int visca_session_resume(t_visca_conn *c) {
+	t_visca_session s, *found;
+	pthread_mutex_lock(&visca_session_lock);
+	found = visca_session_find(visca_session_key(c));
+	if (found)
+		s = *found;
+	pthread_mutex_unlock(&visca_session_lock);
+	if (!found || !visca_session_verify(c, &s))
+		return 0;
+	c->ncameras = s.ncameras;
+	memcpy(c->cameras, s.cameras, sizeof(c->cameras));
+	return 1;
+}
+
+// bring the chain up: a verified cached session, else the full exchange
+// (caller holds iface_lock)
+static const char *visca_handshake(t_visca_conn *c) {
+	const char *err;
+	int i;
+	if ((c->resumed = visca_session_resume(c))) {
+		for (i = 1; i <= VISCA_MAX_CAMERAS; i++)
+			c->cameras[i].address = i;
+		return 0;
+	}
+	if ((err = visca_handshake_full(c)))
+		return err;
+	visca_session_store(c);
+	return 0;
+}
+
+// by-id/by-path links are what users pass, hotplug reports the node itself
+static void visca_link_resolve(t_visca_conn *c, const char *name) {
+#ifndef _WIN32
+	char path[PATH_MAX];
+#endif
+	snprintf(c->port_name, sizeof(c->port_name), "%s", name);
+	snprintf(c->kernel_name, sizeof(c->kernel_name), "%s", name);
+#ifndef _WIN32
+	if (realpath(name, path))
+		snprintf(c->kernel_name, sizeof(c->kernel_name), "%s", path);
+#endif
+}
+
+// remember how to find this port again after it re-enumerates
+static void visca_link_identify(t_visca_conn *c, const char *name) {
+	struct sp_port *port;
+	const char *serial;
+	visca_link_resolve(c, name);
+	c->usb_serial[0] = 0;
+	if (sp_get_port_by_name(name, &port) == SP_OK) {
+		if ((serial = sp_get_port_usb_serial(port)))
+			snprintf(c->usb_serial, sizeof(c->usb_serial), "%s", serial);
+		sp_free_port(port);
+	}
+}
+
+// switch the adapter to low latency (driver flag, FTDI latency timer)
+// while we hold a libserialport handle on it; closing restores the settings
+static void visca_latency_apply(t_visca_conn *c) {
+	struct sp_port *port;
+	float out[1];
+	c->latency_tried = 1;
+	out[0] = 0;
+	if (sp_get_port_by_name(c->port_name, &port) == SP_OK) {
+		if (sp_open(port, SP_MODE_READ) == SP_OK) {
+			if (sp_set_low_latency(port, 1) == SP_OK)
+				c->latency_port = port;
+			else
+				sp_close(port);
+#ifdef VISCA_POSIX
+			// sp_open() reset the line to its own raw mode: put libvisca's back
+			pthread_mutex_lock(&c->iface_lock);
+			if (c->iface.port_fd != -1)
+				tcsetattr(c->iface.port_fd, TCSANOW, &c->iface.options);
+			pthread_mutex_unlock(&c->iface_lock);
+#endif
+		}
+		if (!c->latency_port)
+			sp_free_port(port);
+		else
+			out[0] = 1;
+	}
+	visca_conn_broadcast(c, s_latency, 1, out);
+}
+
+static void visca_latency_release(t_visca_conn *c) {
+	c->latency_tried = 0;
+	if (!c->latency_port)
+		return;
+	sp_close(c->latency_port);
+	sp_free_port(c->latency_port);
+	c->latency_port = 0;
+}
+
+static void visca_link_down(t_visca_conn *c) {
+	float out[1];
+	int i;
+	visca_latency_release(c);
+	pthread_mutex_lock(&c->iface_lock);
+	if (c->iface.port_fd != -1)
+		VISCA_close_serial(&c->iface);
+	pthread_mutex_unlock(&c->iface_lock);
+	pthread_mutex_lock(&c->io_lock);
+	c->link_up = 0;
+	c->link_lost_ms = visca_now_ms();
+	// whatever the heads were doing, they have to be commanded again
+	for (i = 0; i < c->nclients; i++) {
+		c->clients[i]->track.pan_dir = c->clients[i]->track.tilt_dir = 0;
+		c->clients[i]->follow.pan_dir = c->clients[i]->follow.tilt_dir = 0;
+		c->clients[i]->follow.zoom_dir = c->clients[i]->follow.settled = 0;
+	}
+	// and where they are has to be asked again
+	for (i = 1; i <= VISCA_MAX_CAMERAS; i++) {
+		visca_estimate_rebase(&c->estimates[i], c->link_lost_ms);
+		memset(c->estimates[i].vel, 0, sizeof(c->estimates[i].vel));
+		c->estimates[i].known = 0;
+	}
+	// completions of running commands are lost with the port
+	memset(c->running, 0, sizeof(c->running));
+	c->nrunning = 0;
+	pthread_mutex_unlock(&c->io_lock);
+	out[0] = 0;
+	visca_conn_broadcast(c, s_link, 1, out);
+}
+
+// look for our adapter (by USB serial, else by name) and bring the link back
+static void visca_link_reconnect(t_visca_conn *c) {
+	struct sp_port **ports;
+	char name[sizeof(c->port_name)];
+	const char *serial, *err = "port not found";
+	float out[3];
+	int i;
+
+	snprintf(name, sizeof(name), "%s", c->port_name);
+	if (c->usb_serial[0] && sp_list_ports(&ports) == SP_OK) {
+		for (i = 0; ports[i]; i++) {
+			serial = sp_get_port_usb_serial(ports[i]);
+			if (serial && !strcmp(serial, c->usb_serial)) {
+				snprintf(name, sizeof(name), "%s", sp_get_port_name(ports[i]));
+				break;
+			}
+		}
+		sp_free_port_list(ports);
+	}
+
+	pthread_mutex_lock(&c->iface_lock);
+	if (VISCA_open_serial(&c->iface, name) == VISCA_SUCCESS) {
+		if ((err = visca_handshake(c)))
+			VISCA_close_serial(&c->iface);
+	}
+	pthread_mutex_unlock(&c->iface_lock);
+	if (err)
+		return;
+
+	visca_link_resolve(c, name);
+	pthread_mutex_lock(&c->io_lock);
+	c->link_up = 1;
+	out[1] = visca_now_ms() - c->link_lost_ms;
+	pthread_mutex_unlock(&c->io_lock);
+	out[0] = 1;
+	out[2] = c->resumed;
+	visca_conn_broadcast(c, s_link, 3, out);
+}
+
+// drain hotplug events and reconnect when our adapter comes back
+static void visca_link_supervise(t_visca_conn *c, double now, double *next_rescan) {
+	enum sp_hotplug_event ev;
+	char name[sizeof(c->port_name)];
+	int removed = 0, added = 0, want;
+
+	while (c->hotplug && sp_read_hotplug_event(c->hotplug, &ev, name, sizeof(name)) == SP_OK
+		&& ev != SP_HOTPLUG_NONE) {
+		if (ev == SP_HOTPLUG_REMOVED && !strcmp(name, c->kernel_name))
+			removed = 1;
+		else if (ev == SP_HOTPLUG_ADDED)
+			added = 1;
+	}
+	if (removed && c->link_up)
+		visca_link_down(c);
+	// device nodes can appear before they are accessible: keep retrying
+	if (!c->link_up && (added || now >= *next_rescan)) {
+		visca_link_reconnect(c);
+		*next_rescan = now + VISCA_RECONNECT_MS;
+	}
+	if (c->link_up) {
+		pthread_mutex_lock(&c->io_lock);
+		want = c->low_latency;
+		pthread_mutex_unlock(&c->io_lock);
+		if (want && !c->latency_tried)
+			visca_latency_apply(c);
+		else if (!want && c->latency_tried)
+			visca_latency_release(c);
+	}
+}
+/*-------------------------------------------*/
+
+
+
+// pan_dir: -1 left, 1 right; tilt_dir: -1 up, 1 down; 0 stops the axis
+static void visca_drive_packet(VISCAPacket_t *packet, int pan_dir, int tilt_dir, int pan_speed, int tilt_speed) {
+	if (pan_speed < 1) pan_speed = 1;
+	if (pan_speed > VISCA_PAN_SPEED_MAX) pan_speed = VISCA_PAN_SPEED_MAX;
+	if (tilt_speed < 1) tilt_speed = 1;
+	if (tilt_speed > VISCA_TILT_SPEED_MAX) tilt_speed = VISCA_TILT_SPEED_MAX;
+	_VISCA_init_packet(packet);
+	_VISCA_append_byte(packet, VISCA_COMMAND);
+	_VISCA_append_byte(packet, VISCA_CATEGORY_PAN_TILTER);
+	_VISCA_append_byte(packet, VISCA_PT_DRIVE);
+	_VISCA_append_byte(packet, pan_speed);
+	_VISCA_append_byte(packet, tilt_speed);
+	_VISCA_append_byte(packet, pan_dir < 0 ? VISCA_PT_DRIVE_HORIZ_LEFT
+		: pan_dir > 0 ? VISCA_PT_DRIVE_HORIZ_RIGHT : VISCA_PT_DRIVE_HORIZ_STOP);
+	_VISCA_append_byte(packet, tilt_dir < 0 ? VISCA_PT_DRIVE_VERT_UP
+		: tilt_dir > 0 ? VISCA_PT_DRIVE_VERT_DOWN : VISCA_PT_DRIVE_VERT_STOP);
+}
+
+// caller holds iface_lock
+static uint32_t visca_drive(t_visca_conn *c, int camera, int pan_dir, int tilt_dir, int pan_speed, int tilt_speed) {
+	VISCAPacket_t packet;
+	visca_drive_packet(&packet, pan_dir, tilt_dir, pan_speed, tilt_speed);
+	return _VISCA_send_packet_with_reply(&c->iface, &c->cameras[camera], &packet);
+}
+
+// map a controller output in [-1, 1] to a direction and speed index
+static void visca_track_axis(float u, float err, float deadband, int max, int *dir, int *speed) {
+	if (fabsf(err) < deadband) {
+		*dir = 0;
+		*speed = 1;
+		return;
+	}
+	*dir = u < 0 ? -1 : 1;
+	*speed = (int)lrintf(fabsf(u) * max);
+	if (*speed < 1) *speed = 1;
+	if (*speed > max) *speed = max;
+}
+
+// shortest loop period (ms) that keeps the tracker inside its share of the link
+static double visca_track_period(const t_visca_track *t) {
+	double period = 1000.0 / (t->rate > 0 ? t->rate : 1);
+	double budget = t->budget > 0 && t->budget <= 1 ? t->budget : 1;
+	double floor_ms = (VISCA_TRACK_INQ_BYTES + VISCA_TRACK_DRIVE_BYTES) * VISCA_BYTE_MS / budget;
+	return period > floor_ms ? period : floor_ms;
+}
+
+// one iteration of the tracking loop, called from the I/O thread with
+// client_lock; 0 when x detached meanwhile
+static int visca_track_step(t_visca *x, const t_visca_track *p, double dt) {
+	t_visca_conn *c = x->conn;
+	t_visca_track *t = &x->track;
+	uint8_t xpos, ypos, status;
+	float ex, ey, ux, uy;
+	int pan_dir, tilt_dir, pan_speed, tilt_speed;
+	float out[5];
+	uint32_t err;
+	int alive, urgent, camera = x->address;
+
+	visca_wire_lock(c);
+	err = VISCA_get_at_obj_pos(&c->iface, &c->cameras[camera], &xpos, &ypos, &status);
+	alive = err == VISCA_SUCCESS || visca_port_alive(c);
+	visca_wire_unlock(c);
+	if (!alive)
+		visca_link_down(c);
+	if (!visca_conn_has(c, x))
+		return 0;
+	if (err != VISCA_SUCCESS)
+		return 1;
+
+	if (status == VISCA_AT_STATUS_TRACKING) {
+		ex = (xpos - p->center_x) / p->range_x;
+		ey = (ypos - p->center_y) / p->range_y;
+		if (ex > 1) ex = 1; else if (ex < -1) ex = -1;
+		if (ey > 1) ey = 1; else if (ey < -1) ey = -1;
+		// integrators are clamped so a lost target does not wind up
+		t->int_x += ex * dt;
+		t->int_y += ey * dt;
+		if (t->int_x > 1) t->int_x = 1; else if (t->int_x < -1) t->int_x = -1;
+		if (t->int_y > 1) t->int_y = 1; else if (t->int_y < -1) t->int_y = -1;
+		// a target just (re)acquired has no previous error: no derivative kick
+		if (!t->acquired) {
+			t->err_x = ex;
+			t->err_y = ey;
+			t->acquired = 1;
+		}
+		ux = p->kp * ex + p->ki * t->int_x + p->kd * (ex - t->err_x) / dt;
+		uy = p->kp * ey + p->ki * t->int_y + p->kd * (ey - t->err_y) / dt;
+		t->err_x = ex;
+		t->err_y = ey;
+		visca_track_axis(ux, ex, p->deadband, VISCA_PAN_SPEED_MAX, &pan_dir, &pan_speed);
+		visca_track_axis(uy, ey, p->deadband, VISCA_TILT_SPEED_MAX, &tilt_dir, &tilt_speed);
+	} else {
+		t->int_x = t->int_y = t->err_x = t->err_y = 0;
+		t->acquired = 0;
+		pan_dir = tilt_dir = 0;
+		pan_speed = tilt_speed = 1;
+	}
+
+	// a stop waiting in the queue goes first; the drive is retried next step
+	pthread_mutex_lock(&c->io_lock);
+	urgent = c->queues[VISCA_PRIO_SAFETY].head != c->queues[VISCA_PRIO_SAFETY].tail;
+	pthread_mutex_unlock(&c->io_lock);
+
+	// only spend link time on a drive command when the motion changes
+	if (!urgent && (pan_dir != t->pan_dir || tilt_dir != t->tilt_dir
+		|| (pan_dir && pan_speed != t->pan_speed)
+		|| (tilt_dir && tilt_speed != t->tilt_speed))) {
+		visca_wire_lock(c);
+		err = visca_drive(c, camera, pan_dir, tilt_dir, pan_speed, tilt_speed);
+		visca_wire_unlock(c);
+		if (!visca_conn_has(c, x)) {
+			// closed meanwhile: detach did not see this drive, stop it here
+			if (err == VISCA_SUCCESS && (pan_dir || tilt_dir)) {
+				visca_wire_lock(c);
+				visca_drive(c, camera, 0, 0, 1, 1);
+				visca_wire_unlock(c);
+			}
+			return 0;
+		}
+		if (err == VISCA_SUCCESS) {
+			t->pan_dir = pan_dir;
+			t->tilt_dir = tilt_dir;
+			t->pan_speed = pan_speed;
+			t->tilt_speed = tilt_speed;
+			pthread_mutex_lock(&c->io_lock);
+			visca_estimate_pantilt(&c->estimates[x->address], visca_now_ms(),
+				pan_dir, tilt_dir, pan_speed, tilt_speed);
+			pthread_mutex_unlock(&c->io_lock);
+		}
+	}
+
+	out[0] = xpos;
+	out[1] = ypos;
+	out[2] = status;
+	out[3] = t->pan_dir * t->pan_speed;
+	out[4] = t->tilt_dir * t->tilt_speed;
+	visca_post_event(x, s_track, 5, out);
+	return 1;
+}
+
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// I/O Command Queue
+/*-------------------------------------------*/
+// the socket a cancel (8x 2p) names, or 0 for any other packet
+static int visca_cmd_cancel(const VISCAPacket_t *packet) {
+	const unsigned char *b = packet->bytes + 1;
+	return packet->length == 2 && (b[0] & 0xF0) == 0x20 ? b[0] & 0x0F : 0;
+}
+
+// which class a packet belongs to: stops and cancels are safety, the rest
+// of the pan/tilt, zoom and focus drives and moves are motion, inquiries go last
+static int visca_cmd_prio(const VISCAPacket_t *packet) {
+	const unsigned char *b = packet->bytes + 1;   // after the header byte
+	if (visca_cmd_cancel(packet))
+		return VISCA_PRIO_SAFETY;
+	// a [raw( packet may be shorter than any command or inquiry
+	if (packet->length < 4)
+		return VISCA_PRIO_SETTINGS;
+	if (b[0] == VISCA_INQUIRY)
+		return VISCA_PRIO_INQUIRY;
+	if (b[0] == VISCA_COMMAND && b[1] == VISCA_CATEGORY_PAN_TILTER && b[2] == VISCA_PT_DRIVE
+		&& packet->length == 8 && b[5] == VISCA_PT_DRIVE_HORIZ_STOP && b[6] == VISCA_PT_DRIVE_VERT_STOP)
+		return VISCA_PRIO_SAFETY;
+	if (b[0] == VISCA_COMMAND && b[1] == VISCA_CATEGORY_CAMERA1 && packet->length == 5
+		&& ((b[2] == VISCA_ZOOM && b[3] == VISCA_ZOOM_STOP)
+		|| (b[2] == VISCA_FOCUS && b[3] == VISCA_FOCUS_STOP)))
+		return VISCA_PRIO_SAFETY;
+	if (b[0] == VISCA_COMMAND && b[1] == VISCA_CATEGORY_INTERFACE)
+		return VISCA_PRIO_SAFETY;
+	if (b[0] == VISCA_COMMAND && (b[1] == VISCA_CATEGORY_PAN_TILTER
+		|| (b[1] == VISCA_CATEGORY_CAMERA1 && (b[2] == VISCA_ZOOM || b[2] == VISCA_FOCUS
+		|| b[2] == VISCA_ZOOM_VALUE || b[2] == VISCA_FOCUS_VALUE))))
+		return VISCA_PRIO_MOTION;
+	return VISCA_PRIO_SETTINGS;
+}
+
+// the drives a stop halts, or a motion command moves: 1 pan/tilt, 2 zoom,
+// 4 focus; cancels and interface commands reach all of them
+static int visca_cmd_axes(const VISCAPacket_t *packet) {
+	const unsigned char *b = packet->bytes + 1;
+	if (visca_cmd_cancel(packet) || packet->length < 4 || b[0] != VISCA_COMMAND)
+		return 7;
+	if (b[1] == VISCA_CATEGORY_PAN_TILTER)
+		return 1;
+	if (b[1] == VISCA_CATEGORY_CAMERA1 && (b[2] == VISCA_ZOOM || b[2] == VISCA_ZOOM_VALUE))
+		return 2;
+	if (b[1] == VISCA_CATEGORY_CAMERA1 && (b[2] == VISCA_FOCUS || b[2] == VISCA_FOCUS_VALUE))
+		return 4;
+	return 7;
+}
+
+// what a [done( event calls a frame (header to terminator): moves to a
+// target, not drives, which complete as soon as they start; 0 for the rest
+static t_symbol *visca_done_name(const unsigned char *frame) {
+	const unsigned char *b = frame + 1;
+	if (b[0] != VISCA_COMMAND)
+		return 0;
+	if (b[1] == VISCA_CATEGORY_PAN_TILTER)
+		return b[2] == VISCA_PT_ABSOLUTE_POSITION || b[2] == VISCA_PT_RELATIVE_POSITION ? s_pantilt
+			: b[2] == VISCA_PT_HOME ? s_home : b[2] == VISCA_PT_RESET ? s_reset : 0;
+	if (b[1] == VISCA_CATEGORY_CAMERA1)
+		return b[2] == VISCA_MEMORY && b[3] == VISCA_MEMORY_RECALL ? s_preset
+			: b[2] == VISCA_ZOOM_VALUE ? s_zoom : b[2] == VISCA_FOCUS_VALUE ? s_focus : 0;
+	return 0;
+}
+
+// queue a command for the I/O thread; a newer drive or position target for
+// the same camera replaces a queued one, a stop also cancels the camera's
+// queued and timed motion on the axes it halts; timed commands wait apart
+// until their instant
+static int visca_io_submit(t_visca_conn *c, const t_visca_cmd *cmd) {
+	t_visca_queue *q = &c->queues[cmd->prio];
+	t_visca_queue *m = &c->queues[VISCA_PRIO_MOTION];
+	int i, n, next, axes = visca_cmd_axes(&cmd->packet);
+	pthread_mutex_lock(&c->io_lock);
+	if (cmd->at > 0) {
+		if (c->ntimed == VISCA_TIMED_QUEUE) {
+			pthread_mutex_unlock(&c->io_lock);
+			return 0;
+		}
+		c->timed[c->ntimed++] = *cmd;
+		pthread_mutex_unlock(&c->io_lock);
+		sp_event_set_wakeup(c->io_events);
+		return 1;
+	}
+	if (cmd->prio == VISCA_PRIO_SAFETY) {
+		for (i = n = m->head; i != m->tail; i = (i + 1) % VISCA_CMD_QUEUE) {
+			if (m->cmds[i].camera == cmd->camera && (visca_cmd_axes(&m->cmds[i].packet) & axes))
+				continue;
+			m->cmds[n] = m->cmds[i];
+			n = (n + 1) % VISCA_CMD_QUEUE;
+		}
+		m->tail = n;
+		for (i = n = 0; i < c->ntimed; i++)
+			if (c->timed[i].prio != VISCA_PRIO_MOTION || c->timed[i].camera != cmd->camera
+				|| !(visca_cmd_axes(&c->timed[i].packet) & axes))
+				c->timed[n++] = c->timed[i];
+		c->ntimed = n;
+	}
+	if (cmd->kind == VISCA_CMD_DRIVE || cmd->kind == VISCA_CMD_ZOOM
+		|| cmd->kind == VISCA_CMD_FOCUS || cmd->kind == VISCA_CMD_PANTILT_ABS) {
+		for (i = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE) {
+			if (q->cmds[i].kind == cmd->kind && q->cmds[i].camera == cmd->camera) {
+				q->cmds[i] = *cmd;
+				pthread_mutex_unlock(&c->io_lock);
+				sp_event_set_wakeup(c->io_events);
+				return 1;
+			}
+		}
+	}
+	next = (q->tail + 1) % VISCA_CMD_QUEUE;
+	if (next == q->head) {
+		pthread_mutex_unlock(&c->io_lock);
+		return 0;
+	}
+	q->cmds[q->tail] = *cmd;
+	q->tail = next;
+	pthread_mutex_unlock(&c->io_lock);
+	sp_event_set_wakeup(c->io_events);
+	return 1;
+}
+
+// stop drives an object leaves running as it goes: queued ahead of anything
+// else, with no one to report to
+static void visca_io_halt(t_visca_conn *c, int camera, int pantilt, int zoom) {
+	t_visca_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.camera = camera;
+	cmd.queued = visca_now_ms();
+	if (pantilt) {
+		cmd.kind = VISCA_CMD_DRIVE;
+		visca_drive_packet(&cmd.packet, 0, 0, 1, 1);
+		cmd.prio = visca_cmd_prio(&cmd.packet);
+		visca_io_submit(c, &cmd);
+	}
+	if (zoom) {
+		cmd.kind = VISCA_CMD_ZOOM;
+		_VISCA_init_packet(&cmd.packet);
+		_VISCA_append_byte(&cmd.packet, VISCA_COMMAND);
+		_VISCA_append_byte(&cmd.packet, VISCA_CATEGORY_CAMERA1);
+		_VISCA_append_byte(&cmd.packet, VISCA_ZOOM);
+		_VISCA_append_byte(&cmd.packet, VISCA_ZOOM_STOP);
+		cmd.prio = visca_cmd_prio(&cmd.packet);
+		visca_io_submit(c, &cmd);
+	}
+}
+
+// wire bytes a command costs: packet, terminator and the replies it draws
+static int visca_cmd_cost(const t_visca_cmd *cmd) {
+	const t_visca_cue *cue;
+	if (cmd->kind == VISCA_CMD_CUE) {
+		cue = &cmd->owner->bank->cues[cmd->cue];
+		return cue->bytes + cue->nframes * VISCA_REPLY_BYTES;
+	}
+	return cmd->packet.length + 1
+		+ (cmd->prio == VISCA_PRIO_INQUIRY ? VISCA_INQ_REPLY_BYTES : VISCA_REPLY_BYTES);
+}
+
+// remove entry i from a queue, keeping the order of the rest
+static t_visca_cmd visca_queue_take(t_visca_queue *q, int i) {
+	t_visca_cmd cmd = q->cmds[i];
+	int next;
+	for (; (next = (i + 1) % VISCA_CMD_QUEUE) != q->tail; i = next)
+		q->cmds[i] = q->cmds[next];
+	q->tail = i;
+	return cmd;
+}
+
+// oldest entry for a camera, or -1
+static int visca_queue_find(const t_visca_queue *q, int camera) {
+	int i;
+	for (i = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE)
+		if (q->cmds[i].camera == camera)
+			return i;
+	return -1;
+}
+
+// a camera runs two commands at once: motion for it waits while both of
+// its sockets are taken, a third would only draw a buffer-full error; a
+// cue fills every socket, so it waits until nothing runs
+static int visca_cmd_blocked(const t_visca_conn *c, const t_visca_cmd *cmd) {
+	int socket, n = 0;
+	if (cmd->prio != VISCA_PRIO_MOTION)
+		return 0;
+	if (cmd->kind == VISCA_CMD_CUE)
+		return c->nrunning > 0;
+	for (socket = 1; socket <= VISCA_SOCKETS; socket++)
+		n += c->running[cmd->camera][socket].on;
+	return n == VISCA_SOCKETS;
+}
+
+// can a camera's oldest command of a class go out now, for any camera?
+static int visca_queue_ready(const t_visca_conn *c, int prio) {
+	const t_visca_queue *q = &c->queues[prio];
+	int i, cam;
+	if (prio != VISCA_PRIO_MOTION)
+		return q->head != q->tail;
+	for (cam = 1; cam <= VISCA_MAX_CAMERAS; cam++)
+		if ((i = visca_queue_find(q, cam)) >= 0 && !visca_cmd_blocked(c, &q->cmds[i]))
+			return 1;
+	return 0;
+}
+
+// deficit round-robin over the cameras with commands in one class
+static int visca_drr_pick(t_visca_conn *c, int prio) {
+	t_visca_queue *q = &c->queues[prio];
+	t_visca_share *sh;
+	int i, cam;
+	for (;;) {
+		cam = c->drr_cur[prio];
+		sh = &c->shares[cam];
+		if ((i = visca_queue_find(q, cam)) >= 0 && !visca_cmd_blocked(c, &q->cmds[i])) {
+			if (c->drr_fresh[prio]) {
+				sh->deficit[prio] += sh->weight * VISCA_DRR_QUANTUM;
+				c->drr_fresh[prio] = 0;
+			}
+			if (visca_cmd_cost(&q->cmds[i]) <= sh->deficit[prio]) {
+				sh->deficit[prio] -= visca_cmd_cost(&q->cmds[i]);
+				return i;
+			}
+		} else
+			// an idle camera does not bank credit
+			sh->deficit[prio] = 0;
+		c->drr_cur[prio] = cam % VISCA_MAX_CAMERAS + 1;
+		c->drr_fresh[prio] = 1;
+	}
+}
+
+// take the next command, highest class first, dropping stale ones; stops
+// go strictly in order, other classes share the link between cameras
+// (caller holds io_lock); with hold set only stops go. Returns 0 when
+// nothing can go out
+static int visca_io_next(t_visca_conn *c, double now, int hold, t_visca_cmd *cmd) {
+	t_visca_queue *q;
+	t_visca_share *sh;
+	float out[1];
+	int i, prio;
+	for (prio = 0; prio < (hold ? VISCA_PRIO_MOTION : VISCA_PRIO_CLASSES); prio++) {
+		q = &c->queues[prio];
+		for (i = q->head; i != q->tail;) {
+			if (q->cmds[i].deadline == 0 || now <= q->cmds[i].deadline) {
+				i = (i + 1) % VISCA_CMD_QUEUE;
+				continue;
+			}
+			*cmd = visca_queue_take(q, i);
+			c->shares[cmd->camera].expired++;
+			out[0] = cmd->camera;
+			visca_post_event(cmd->owner, s_expired, 1, out);
+		}
+		if (!visca_queue_ready(c, prio))
+			continue;
+		*cmd = visca_queue_take(q, prio == VISCA_PRIO_SAFETY ? q->head : visca_drr_pick(c, prio));
+		sh = &c->shares[cmd->camera];
+		sh->sent++;
+		sh->bytes += visca_cmd_cost(cmd);
+		sh->wait_sum += now - cmd->queued;
+		if (now - cmd->queued > sh->wait_max)
+			sh->wait_max = now - cmd->queued;
+		return 1;
+	}
+	return 0;
+}
+
+// decode a signed 16 bit value sent as four nibbles
+static int visca_nibbles(const unsigned char *b) {
+	int v = (b[0] & 0xF) << 12 | (b[1] & 0xF) << 8 | (b[2] & 0xF) << 4 | (b[3] & 0xF);
+	return v >= 0x8000 ? v - 0x10000 : v;
+}
+
+// and back: 16 bits as four nibbles
+static void visca_append_nibbles(VISCAPacket_t *packet, int v) {
+	_VISCA_append_byte(packet, (v >> 12) & 0x0F);
+	_VISCA_append_byte(packet, (v >> 8) & 0x0F);
+	_VISCA_append_byte(packet, (v >> 4) & 0x0F);
+	_VISCA_append_byte(packet, v & 0x0F);
+}
+
+// a command or cue frame completed: a direct position is where the axis
+// now is
+static void visca_estimate_frame(t_visca_estimate *e, double now, const unsigned char *frame, int length) {
+	const unsigned char *b = frame + 1;
+	VISCAPacket_t packet;
+	if (b[0] == VISCA_COMMAND && b[1] == VISCA_CATEGORY_PAN_TILTER
+		&& b[2] == VISCA_PT_ABSOLUTE_POSITION && length >= 15) {
+		visca_estimate_fix(e, now, VISCA_AXIS_PAN, visca_nibbles(b + 5));
+		visca_estimate_fix(e, now, VISCA_AXIS_TILT, visca_nibbles(b + 9));
+		e->vel[VISCA_AXIS_PAN] = e->vel[VISCA_AXIS_TILT] = 0;
+	} else if (b[0] == VISCA_COMMAND && b[1] == VISCA_CATEGORY_CAMERA1
+		&& b[2] == VISCA_ZOOM_VALUE && length >= 9) {
+		visca_estimate_fix(e, now, VISCA_AXIS_ZOOM, visca_nibbles(b + 3));
+		e->vel[VISCA_AXIS_ZOOM] = 0;
+	} else if (length <= (int)sizeof(packet.bytes)) {
+		memcpy(packet.bytes, frame, length);
+		packet.length = length;
+		visca_estimate_command(e, now, &packet);
+	}
+}
+
+// fold a measured inquiry round trip into the link latency (caller holds
+// io_lock)
+static void visca_rtt_sample(t_visca_conn *c, double ms) {
+	c->rtt = c->rtt > 0 ? c->rtt + (ms - c->rtt) * VISCA_RTT_GAIN : ms;
+}
+
+// a command came back at its ACK: keep it until its completion is collected
+// (caller holds io_lock)
+static void visca_io_run(t_visca_conn *c, const t_visca_cmd *cmd, int socket) {
+	t_visca_running *r = &c->running[cmd->camera][socket];
+	if (!r->on)
+		c->nrunning++;
+	r->on = 1;
+	r->cmd = *cmd;
+	r->acked = r->checked = visca_now_ms();
+}
+
+// a cancel is answered by the error of the command it cancels, as that
+// command's completion, or with error 5 when the socket is idle: no reply
+// is awaited, both are collected with the completions (caller holds
+// client_lock)
+static void visca_io_cancel(t_visca_conn *c, t_visca_cmd *cmd, int socket) {
+	uint32_t err;
+	int alive;
+	visca_wire_lock(c);
+	c->iface.deferred[c->cameras[cmd->camera].address] |= 1 << socket;
+	err = _VISCA_send_packet(&c->iface, &c->cameras[cmd->camera], &cmd->packet);
+	cmd->sent = visca_now_ms();
+	alive = err == VISCA_SUCCESS || visca_port_alive(c);
+	visca_wire_unlock(c);
+	if (!alive)
+		visca_link_down(c);
+}
+
+// a command that returned at its ACK is over: [raw( gets the completion
+// as the reply, [ack_return 1( reports [completed camera error ms(, and
+// [done cmd camera( follows when it went fine
+static void visca_io_finish(t_visca_conn *c, int camera, int socket, int error) {
+	t_visca_running r;
+	t_symbol *done;
+	float out[3], raw[4];
+	double now = visca_now_ms();
+	int report, nraw = 0;
+	pthread_mutex_lock(&c->io_lock);
+	r = c->running[camera][socket];
+	if (r.on) {
+		c->running[camera][socket].on = 0;
+		c->nrunning--;
+		if (!error)
+			visca_estimate_frame(&c->estimates[camera], now, r.cmd.packet.bytes, r.cmd.packet.length);
+	}
+	report = c->ack_return;
+	pthread_mutex_unlock(&c->io_lock);
+	if (!r.on || !r.cmd.owner)
+		return;
+	if (r.cmd.kind == VISCA_CMD_RAW) {
+		raw[nraw++] = (camera + 8) << 4;   // reply header, as the camera sent it
+		raw[nraw++] = (error ? VISCA_RESPONSE_ERROR : VISCA_RESPONSE_COMPLETED) | socket;
+		if (error)
+			raw[nraw++] = error;
+		raw[nraw++] = VISCA_TERMINATOR;
+		visca_post_event(r.cmd.owner, s_raw, nraw, raw);
+	}
+	out[0] = camera;
+	out[1] = error;
+	out[2] = now - r.acked;
+	if (report)
+		visca_post_event(r.cmd.owner, s_completed, 3, out);
+	if (!error && (done = visca_done_name(r.cmd.packet.bytes)))
+		visca_post_event_sym(r.cmd.owner, s_done, done, 1, out);
+}
+
+// send one queued command (caller holds client_lock); if the port died, put
+// it back for replay. Motion returns at its ACK, so a stop queued behind a
+// long move waits only for the ACK; the completion is collected later.
+static void visca_io_send(t_visca_conn *c, t_visca_cmd *cmd) {
+	t_visca_queue *q = &c->queues[cmd->prio];
+	t_visca_estimate *e = &c->estimates[cmd->camera];
+	t_symbol *done;
+	uint32_t err;
+	int alive, type, socket, learn = 0, nout = 0, nraw = 0;
+	float out[3], pos[VISCA_AXES], raw[VISCA_EVENT_ATOMS];
+	double now, start;
+	if ((socket = visca_cmd_cancel(&cmd->packet))) {
+		visca_io_cancel(c, cmd, socket);
+		return;
+	}
+	visca_wire_lock(c);
+	start = visca_now_ms();
+	// the write and the wait for the reply apart, to know when it went
+	err = _VISCA_send_packet(&c->iface, &c->cameras[cmd->camera], &cmd->packet);
+	cmd->sent = visca_now_ms();
+	if (err == VISCA_SUCCESS) {
+		VISCA_set_ack_mode(&c->iface, cmd->prio == VISCA_PRIO_MOTION);
+		err = _VISCA_get_reply(&c->iface, &c->cameras[cmd->camera]);
+		VISCA_set_ack_mode(&c->iface, 0);
+	}
+	alive = err == VISCA_SUCCESS || visca_port_alive(c);
+	type = c->iface.type & 0xF0;
+	socket = c->iface.ibuf[1] & 0x0F;
+	out[0] = c->iface.ibuf[2];
+	// [raw( gets the whole reply, error replies included; an ACK is not
+	// the reply, the completion is
+	if (cmd->kind == VISCA_CMD_RAW && err == VISCA_SUCCESS && type != VISCA_RESPONSE_ACK)
+		for (; nraw < (int)c->iface.bytes && nraw < VISCA_EVENT_ATOMS; nraw++)
+			raw[nraw] = c->iface.ibuf[nraw];
+	if (cmd->kind == VISCA_CMD_PANTILT_POS && c->iface.bytes >= 11) {
+		out[0] = visca_nibbles(c->iface.ibuf + 2);
+		out[1] = visca_nibbles(c->iface.ibuf + 6);
+		nout = 2;
+	} else if (cmd->kind == VISCA_CMD_ZOOM_POS && c->iface.bytes >= 7) {
+		out[0] = visca_nibbles(c->iface.ibuf + 2);
+		nout = 1;
+	} else if (cmd->kind == VISCA_CMD_FOCUS_LEARN && c->iface.bytes >= 7) {
+		out[1] = visca_nibbles(c->iface.ibuf + 2);
+		learn = 1;
+	}
+	visca_wire_unlock(c);
+	// asked by an object that closed meanwhile: nothing to report
+	if (cmd->owner && !visca_conn_has(c, cmd->owner))
+		cmd->owner = 0;
+	// ACKed: the motion runs on, its completion is collected later
+	if (err == VISCA_SUCCESS && type == VISCA_RESPONSE_ACK) {
+		if (socket < 1 || socket > VISCA_SOCKETS)
+			return;
+		pthread_mutex_lock(&c->io_lock);
+		visca_io_run(c, cmd, socket);
+		pthread_mutex_unlock(&c->io_lock);
+		return;
+	}
+	if (nraw)
+		visca_post_event(cmd->owner, s_raw, nraw, raw);
+	else if (err == VISCA_SUCCESS && type == VISCA_RESPONSE_ERROR)
+		visca_post_event(cmd->owner, s_error, 1, out);
+	else if (err == VISCA_SUCCESS) {
+		now = visca_now_ms();
+		pthread_mutex_lock(&c->io_lock);
+		if (cmd->prio == VISCA_PRIO_INQUIRY)
+			visca_rtt_sample(c, now - start);
+		if (learn) {
+			// the zoom inquiry queued just before has fixed the zoom
+			visca_estimate_at(e, now, pos);
+			out[0] = pos[VISCA_AXIS_ZOOM];
+			visca_estimate_focus_point(e, out[0], out[1]);
+			out[2] = e->nfocus;
+		} else if (nout == 2) {
+			visca_estimate_fix(e, now, VISCA_AXIS_PAN, out[0]);
+			visca_estimate_fix(e, now, VISCA_AXIS_TILT, out[1]);
+		} else if (nout == 1)
+			visca_estimate_fix(e, now, VISCA_AXIS_ZOOM, out[0]);
+		else
+			visca_estimate_frame(e, now, cmd->packet.bytes, cmd->packet.length);
+		pthread_mutex_unlock(&c->io_lock);
+		if (nout)
+			visca_post_event(cmd->owner, nout == 2 ? s_position : s_zoom, nout, out);
+		else if (learn)
+			visca_post_event(cmd->owner, s_focus_point, 3, out);
+	}
+	if (err == VISCA_SUCCESS && type == VISCA_RESPONSE_COMPLETED
+		&& (done = visca_done_name(cmd->packet.bytes))) {
+		out[0] = cmd->camera;
+		visca_post_event_sym(cmd->owner, s_done, done, 1, out);
+	}
+	if (alive)
+		return;
+	pthread_mutex_lock(&c->io_lock);
+	if ((q->head + VISCA_CMD_QUEUE - 1) % VISCA_CMD_QUEUE != q->tail) {
+		q->head = (q->head + VISCA_CMD_QUEUE - 1) % VISCA_CMD_QUEUE;
+		q->cmds[q->head] = *cmd;
+	}
+	pthread_mutex_unlock(&c->io_lock);
+	visca_link_down(c);
+}
+
+// drop whatever an object still has queued (caller holds io_lock)
+static void visca_io_purge(t_visca_conn *c, t_visca *x) {
+	t_visca_queue *q;
+	int i, n, prio;
+	for (prio = 0; prio < VISCA_PRIO_CLASSES; prio++) {
+		q = &c->queues[prio];
+		for (i = n = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE) {
+			if (q->cmds[i].owner == x)
+				continue;
+			q->cmds[n] = q->cmds[i];
+			n = (n + 1) % VISCA_CMD_QUEUE;
+		}
+		q->tail = n;
+	}
+	for (i = n = 0; i < c->ntimed; i++)
+		if (c->timed[i].owner != x)
+			c->timed[n++] = c->timed[i];
+	c->ntimed = n;
+	// running commands complete all the same, unreported
+	for (i = 1; i <= VISCA_MAX_CAMERAS; i++)
+		for (n = 1; n <= VISCA_SOCKETS; n++)
+			if (c->running[i][n].cmd.owner == x)
+				c->running[i][n].cmd.owner = 0;
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Cue Playback
+/*-------------------------------------------*/
+/* A cue goes out as one write: for every camera as many of its frames as
+ * the camera has command sockets. Each completion lets that camera's next
+ * frame follow. ACKs tie a frame to the socket its completion will name.
+ * The I/O thread stays with the cue until every frame is answered, a
+ * camera stays silent for VISCA_CUE_TIMEOUT_MS, or a stop is queued.
+ */
+
+#define VISCA_FRAME_UNSENT 0
+#define VISCA_FRAME_SENT 1      // waiting for the ACK
+#define VISCA_FRAME_RUNNING 2   // ACKed, waiting for the completion
+#define VISCA_FRAME_DONE 3
+
+// a cue frame completed: moves report [done cmd camera( as they end
+static void visca_cue_done(t_visca *x, int camera, const unsigned char *frame) {
+	t_symbol *done = visca_done_name(frame);
+	float out[1];
+	if (!done)
+		return;
+	out[0] = camera;
+	visca_post_event_sym(x, s_done, done, 1, out);
+}
+
+// first frame of a camera in a state, or -1
+static int visca_cue_find(const t_visca_frame *f, const char *state, int n, int camera, int want) {
+	int i;
+	for (i = 0; i < n; i++)
+		if (f[i].camera == camera && state[i] == want)
+			return i;
+	return -1;
+}
+
+// a cue frame went fine: the estimate follows it and its object hears of
+// it, if it is still there
+static void visca_cue_frame(t_visca_conn *c, t_visca *owner, int camera, double now,
+	const unsigned char *frame, int length) {
+	pthread_mutex_lock(&c->io_lock);
+	visca_estimate_frame(&c->estimates[camera], now, frame, length);
+	if (visca_conn_has(c, owner))
+		visca_cue_done(owner, camera, frame);
+	pthread_mutex_unlock(&c->io_lock);
+}
+
+// fire a cue and collect its completions; reports [cue index failed
+// latency duration( (caller holds client_lock). The cue is copied first:
+// client_lock is let go for the wait, and the object may close or load
+// another bank meanwhile.
+static void visca_cue_fire(t_visca_conn *c, t_visca_cmd *cmd) {
+	const t_visca_bank *b = cmd->owner->bank;
+	t_visca *owner = cmd->owner;
+	t_visca_cue cue = b->cues[cmd->cue];
+	t_visca_frame f[VISCA_CUE_FRAMES];
+	unsigned char bytes[VISCA_CUE_FRAMES * VISCA_CUE_FRAME_BYTES];
+	char state[VISCA_CUE_FRAMES] = {0};
+	unsigned char socket[VISCA_CUE_FRAMES];
+	double start, last, now;
+	int i, base, left = cue.nframes, failed = 0, alive = 1;
+	float out[4];
+#ifdef VISCA_POSIX
+	// completions of motion sent before the cue, reported once client_lock
+	// is back
+	int finished[VISCA_MAX_CAMERAS * VISCA_SOCKETS][3];
+	struct pollfd pfd;
+	int camera, type, sock, stop, nfinished = 0;
+#else
+	VISCAPacket_t packet;
+	uint32_t err;
+#endif
+
+	// a cue's frames are contiguous in the bank's bytes
+	memcpy(f, b->frames + cue.first, cue.nframes * sizeof(t_visca_frame));
+	base = f[0].offset;
+	memcpy(bytes, b->bytes + base, cue.bytes);
+	for (i = 0; i < cue.nframes; i++)
+		f[i].offset -= base;
+	visca_wire_lock(c);
+	start = last = cmd->sent = visca_now_ms();
+#ifdef VISCA_POSIX
+	if (write(c->iface.port_fd, bytes, cue.wave_bytes) != cue.wave_bytes)
+		alive = 0;
+	cmd->sent = visca_now_ms();
+	for (i = 0; i < cue.wave; i++)
+		state[i] = VISCA_FRAME_SENT;
+	pfd.fd = c->iface.port_fd;
+	pfd.events = POLLIN;
+	while (alive && left > 0) {
+		if (poll(&pfd, 1, VISCA_POLL_MS) < 0 && errno != EINTR) {
+			alive = 0;
+			break;
+		}
+		now = visca_now_ms();
+		if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+			alive = 0;
+			break;
+		}
+		// a stop is looked for between any two replies, not only when the
+		// line is quiet
+		pthread_mutex_lock(&c->io_lock);
+		stop = c->queues[VISCA_PRIO_SAFETY].head != c->queues[VISCA_PRIO_SAFETY].tail;
+		pthread_mutex_unlock(&c->io_lock);
+		if (stop)
+			break;
+		if (!(pfd.revents & POLLIN)) {
+			if (now - last > VISCA_CUE_TIMEOUT_MS)
+				break;
+			continue;
+		}
+		if (_VISCA_get_packet(&c->iface) != VISCA_SUCCESS) {
+			alive = 0;
+			break;
+		}
+		last = now;
+		camera = (c->iface.ibuf[0] >> 4) & 0x07;
+		type = c->iface.ibuf[1] & 0xF0;
+		if (type == VISCA_RESPONSE_ACK) {
+			if ((i = visca_cue_find(f, state, cue.nframes, camera, VISCA_FRAME_SENT)) >= 0) {
+				state[i] = VISCA_FRAME_RUNNING;
+				socket[i] = c->iface.ibuf[1] & 0x0F;
+			}
+			continue;
+		}
+		if (type != VISCA_RESPONSE_COMPLETED && type != VISCA_RESPONSE_ERROR)
+			continue;
+		// motion that was running before the cue
+		sock = c->iface.ibuf[1] & 0x0F;
+		if (c->iface.deferred[camera] & 1 << sock) {
+			c->iface.deferred[camera] &= ~(1 << sock);
+			if (sock <= VISCA_SOCKETS && nfinished < VISCA_MAX_CAMERAS * VISCA_SOCKETS) {
+				finished[nfinished][0] = camera;
+				finished[nfinished][1] = sock;
+				finished[nfinished++][2] = type == VISCA_RESPONSE_ERROR ? c->iface.ibuf[2] : 0;
+			}
+			continue;
+		}
+		// the completion names the socket; errors before an ACK do not
+		for (i = 0; i < cue.nframes; i++)
+			if (f[i].camera == camera && state[i] == VISCA_FRAME_RUNNING
+				&& socket[i] == (c->iface.ibuf[1] & 0x0F))
+				break;
+		if (i == cue.nframes
+			&& (i = visca_cue_find(f, state, cue.nframes, camera, VISCA_FRAME_SENT)) < 0)
+			continue;
+		state[i] = VISCA_FRAME_DONE;
+		left--;
+		if (type == VISCA_RESPONSE_ERROR)
+			failed++;
+		else
+			visca_cue_frame(c, owner, camera, now, bytes + f[i].offset, f[i].length);
+		// the socket is free: the camera's next frame follows
+		if ((i = visca_cue_find(f, state, cue.nframes, camera, VISCA_FRAME_UNSENT)) >= 0) {
+			if (write(c->iface.port_fd, bytes + f[i].offset, f[i].length) != f[i].length)
+				alive = 0;
+			state[i] = VISCA_FRAME_SENT;
+		}
+	}
+	// frames left running complete later: collect those with the rest
+	for (i = 0; i < cue.nframes; i++)
+		if (state[i] == VISCA_FRAME_RUNNING)
+			c->iface.deferred[c->cameras[f[i].camera].address] |= 1 << socket[i];
+#else
+	// without poll() the frames go one at a time
+	for (i = 0; alive && i < cue.nframes; i++) {
+		memcpy(packet.bytes, bytes + f[i].offset, f[i].length - 1);
+		packet.length = f[i].length - 1;
+		err = _VISCA_send_packet_with_reply(&c->iface, &c->cameras[f[i].camera], &packet);
+		alive = err == VISCA_SUCCESS || visca_port_alive(c);
+		left--;
+		if (err != VISCA_SUCCESS || (c->iface.type & 0xF0) == VISCA_RESPONSE_ERROR)
+			failed++;
+		else
+			visca_cue_frame(c, owner, f[i].camera, visca_now_ms(), bytes + f[i].offset, f[i].length);
+	}
+#endif
+	visca_wire_unlock(c);
+#ifdef VISCA_POSIX
+	for (i = 0; i < nfinished; i++)
+		visca_io_finish(c, finished[i][0], finished[i][1], finished[i][2]);
+#endif
+	if (!visca_conn_has(c, owner))
+		cmd->owner = 0;
+
+	// frames never answered count as failed
+	out[0] = cmd->cue;
+	out[1] = failed + left;
+	out[2] = start - cmd->queued;
+	out[3] = visca_now_ms() - start;
+	visca_post_event(cmd->owner, s_cue, 4, out);
+	if (!alive)
+		visca_link_down(c);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Follow Mode
+/*-------------------------------------------*/
+/* A slave copies its master's pose as the estimate predicts it half a
+ * round trip ahead, when a command sent now takes effect. While the master
+ * moves, the slave drives at the master's speed plus what closes the gap
+ * in VISCA_FOLLOW_CATCHUP periods; a drive goes out only when a speed
+ * index changes. Once the master rests, one absolute move parks the slave
+ * on the exact pose. The master's position is polled at the slave's
+ * [estimate_poll( interval, which also keeps the round trip measured.
+ */
+
+// signed speed index for an axis that should run at vel units per second
+// and close err; 0 holds it. current is the index running now.
+static int visca_follow_axis(const float *speeds, int max, int current, float vel, float err,
+	float deadband) {
+	float v, lo, hi;
+	int speed, cur = abs(current);
+	if (vel == 0 && fabsf(err) <= deadband)
+		return 0;
+	v = vel + err * 1000.0 / (VISCA_FOLLOW_CATCHUP * VISCA_FOLLOW_MS);
+	// keep the running index while v stays between its neighbours, so a
+	// speed halfway between two indices does not toggle every step
+	if (current && (v < 0) == (current < 0)) {
+		lo = cur > 1 ? speeds[cur - 1] : speeds[1] / 4;
+		hi = cur < max ? speeds[cur + 1] : speeds[max];
+		if (fabsf(v) > lo && fabsf(v) < hi)
+			return current;
+	}
+	// slower than half the slowest speed: standing is closer
+	if (fabsf(v) < speeds[1] / 2)
+		return 0;
+	speed = visca_speed_index(speeds, max, fabsf(v));
+	return v < 0 ? -speed : speed;
+}
+
+// zoom drive: dir 1 tele, -1 wide, 0 stops
+static void visca_follow_zoom_packet(VISCAPacket_t *packet, int dir, int speed) {
+	_VISCA_init_packet(packet);
+	_VISCA_append_byte(packet, VISCA_COMMAND);
+	_VISCA_append_byte(packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(packet, VISCA_ZOOM);
+	_VISCA_append_byte(packet, dir > 0 ? VISCA_ZOOM_TELE_SPEED | speed
+		: dir < 0 ? VISCA_ZOOM_WIDE_SPEED | speed : VISCA_ZOOM_STOP);
+}
+
+// send a follow command and fold it into the slave's estimate (caller
+// holds client_lock); 0 when it failed. A park returns at its ACK and is
+// folded in at its completion, unreported.
+static int visca_follow_send(t_visca_conn *c, int camera, VISCAPacket_t *packet) {
+	t_visca_cmd cmd;
+	uint32_t err;
+	int alive, park = visca_done_name(packet->bytes) != 0, socket = 0;
+	visca_wire_lock(c);
+	if (park)
+		err = _VISCA_send_packet_with_ack(&c->iface, &c->cameras[camera], packet);
+	else
+		err = _VISCA_send_packet_with_reply(&c->iface, &c->cameras[camera], packet);
+	alive = err == VISCA_SUCCESS || visca_port_alive(c);
+	if ((c->iface.type & 0xF0) == VISCA_RESPONSE_ERROR)
+		err = VISCA_FAILURE;
+	else if ((c->iface.type & 0xF0) == VISCA_RESPONSE_ACK)
+		socket = c->iface.ibuf[1] & 0x0F;
+	visca_wire_unlock(c);
+	if (!alive)
+		visca_link_down(c);
+	if (err != VISCA_SUCCESS)
+		return 0;
+	pthread_mutex_lock(&c->io_lock);
+	if (socket >= 1 && socket <= VISCA_SOCKETS) {
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.prio = VISCA_PRIO_MOTION;
+		cmd.camera = camera;
+		cmd.packet = *packet;
+		visca_io_run(c, &cmd, socket);
+	} else if (!socket)
+		visca_estimate_frame(&c->estimates[camera], visca_now_ms(), packet->bytes, packet->length);
+	pthread_mutex_unlock(&c->io_lock);
+	return 1;
+}
+
+// ask the master where it is (caller holds client_lock); 0 when x
+// detached meanwhile
+static int visca_follow_poll(t_visca *x, int master) {
+	t_visca_conn *c = x->conn;
+	t_visca_estimate *m = &c->estimates[master];
+	int16_t pan, tilt;
+	uint16_t zoom;
+	uint32_t err, zerr = VISCA_FAILURE;
+	double start, end;
+	int alive, moving;
+	visca_wire_lock(c);
+	start = visca_now_ms();
+	err = VISCA_get_pantilt_position(&c->iface, &c->cameras[master], &pan, &tilt);
+	end = visca_now_ms();
+	if (err == VISCA_SUCCESS)
+		zerr = VISCA_get_zoom_value(&c->iface, &c->cameras[master], &zoom);
+	alive = err == VISCA_SUCCESS || visca_port_alive(c);
+	visca_wire_unlock(c);
+	if (!alive) {
+		visca_link_down(c);
+		return visca_conn_has(c, x);
+	}
+	pthread_mutex_lock(&c->io_lock);
+	if (err == VISCA_SUCCESS) {
+		visca_rtt_sample(c, end - start);
+		visca_estimate_fix(m, (start + end) / 2, VISCA_AXIS_PAN, pan);
+		visca_estimate_fix(m, (start + end) / 2, VISCA_AXIS_TILT, tilt);
+	}
+	if (zerr == VISCA_SUCCESS)
+		visca_estimate_fix(m, visca_now_ms(), VISCA_AXIS_ZOOM, zoom);
+	moving = m->vel[VISCA_AXIS_PAN] != 0 || m->vel[VISCA_AXIS_TILT] != 0
+		|| m->vel[VISCA_AXIS_ZOOM] != 0;
+	if (!visca_conn_has(c, x)) {
+		pthread_mutex_unlock(&c->io_lock);
+		return 0;
+	}
+	x->follow.next_poll = start + x->estimate_poll * (moving ? 1 : VISCA_ESTIMATE_IDLE_POLLS);
+	pthread_mutex_unlock(&c->io_lock);
+	return 1;
+}
+
+// stop a slave's pan/tilt and zoom drives (caller holds client_lock)
+static void visca_follow_stop(t_visca_conn *c, int camera, int pantilt, int zoom) {
+	VISCAPacket_t packet;
+	if (pantilt) {
+		visca_drive_packet(&packet, 0, 0, 1, 1);
+		visca_follow_send(c, camera, &packet);
+	}
+	if (zoom) {
+		visca_follow_zoom_packet(&packet, 0, 0);
+		visca_follow_send(c, camera, &packet);
+	}
+}
+
+// stop what a follow left moving (caller holds client_lock); 0 when x
+// detached meanwhile
+static int visca_follow_halt(t_visca *x) {
+	t_visca_conn *c = x->conn;
+	t_visca_follow *f = &x->follow;
+	visca_follow_stop(c, x->address, f->pan_dir || f->tilt_dir, f->zoom_dir);
+	pthread_mutex_lock(&c->io_lock);
+	if (!visca_conn_has(c, x)) {
+		pthread_mutex_unlock(&c->io_lock);
+		return 0;
+	}
+	f->pan_dir = f->tilt_dir = f->zoom_dir = 0;
+	f->settled = 0;
+	pthread_mutex_unlock(&c->io_lock);
+	return 1;
+}
+
+// one follow step, called from the I/O thread with client_lock; 0 when x
+// detached meanwhile (what it had just set moving is stopped)
+static int visca_follow_step(t_visca *x, const t_visca_follow *p) {
+	t_visca_conn *c = x->conn;
+	t_visca_follow *f = &x->follow;
+	t_visca_estimate *m = &c->estimates[p->master];
+	t_visca_estimate *e = &c->estimates[x->address];
+	VISCAPacket_t packet;
+	float mp[VISCA_AXES], sp[VISCA_AXES], target[VISCA_AXES], vel[VISCA_AXES], err[VISCA_AXES];
+	int pan, tilt, zoom, pan_dir, tilt_dir, zoom_dir, pan_speed = 1, tilt_speed = 1;
+	int moving, known, ready, park, park_zoom, urgent, sent, i, camera = x->address;
+	const int pantilt = (1 << VISCA_AXIS_PAN) | (1 << VISCA_AXIS_TILT);
+	double now;
+
+	if (x->estimate_poll > 0 && visca_now_ms() >= p->next_poll && !visca_follow_poll(x, p->master))
+		return 0;
+
+	now = visca_now_ms();
+	pthread_mutex_lock(&c->io_lock);
+	// a command sent now takes effect about half a round trip later
+	visca_estimate_at(m, now + c->rtt / 2, mp);
+	visca_estimate_at(e, now + c->rtt / 2, sp);
+	for (i = 0; i < VISCA_AXES; i++) {
+		target[i] = mp[i];
+		vel[i] = m->vel[i];
+	}
+	if (p->mirror) {
+		target[VISCA_AXIS_PAN] = -target[VISCA_AXIS_PAN];
+		vel[VISCA_AXIS_PAN] = -vel[VISCA_AXIS_PAN];
+	}
+	for (i = 0; i < VISCA_AXES; i++) {
+		target[i] += p->offset[i];
+		if (i == VISCA_AXIS_ZOOM)
+			target[i] = target[i] < 0 ? 0 : target[i] > VISCA_ZOOM_MAX ? VISCA_ZOOM_MAX : target[i];
+		err[i] = target[i] - sp[i];
+	}
+	moving = vel[VISCA_AXIS_PAN] != 0 || vel[VISCA_AXIS_TILT] != 0 || vel[VISCA_AXIS_ZOOM] != 0;
+	known = (e->known & pantilt) == pantilt;
+	pan = tilt = zoom = 0;
+	if (moving && known) {
+		pan = visca_follow_axis(e->pan_speeds, VISCA_PAN_SPEED_MAX, p->pan_dir * p->pan_speed,
+			vel[VISCA_AXIS_PAN], err[VISCA_AXIS_PAN], VISCA_FOLLOW_DEADBAND);
+		tilt = visca_follow_axis(e->tilt_speeds, VISCA_TILT_SPEED_MAX, -p->tilt_dir * p->tilt_speed,
+			vel[VISCA_AXIS_TILT], err[VISCA_AXIS_TILT], VISCA_FOLLOW_DEADBAND);
+		zoom = visca_follow_axis(e->zoom_speeds, VISCA_ZOOM_SPEED_MAX, p->zoom_dir * p->zoom_speed,
+			vel[VISCA_AXIS_ZOOM], err[VISCA_AXIS_ZOOM], VISCA_FOLLOW_ZOOM_DEADBAND);
+	}
+	// the master rests (or the slave's position is still unknown): park
+	park = !p->settled && (!moving || !known) && (!known
+		|| fabsf(err[VISCA_AXIS_PAN]) > VISCA_FOLLOW_DEADBAND
+		|| fabsf(err[VISCA_AXIS_TILT]) > VISCA_FOLLOW_DEADBAND);
+	park_zoom = !p->settled && !moving
+		&& fabsf(err[VISCA_AXIS_ZOOM]) > VISCA_FOLLOW_ZOOM_DEADBAND;
+	if (park)
+		visca_plan_move(e, err[VISCA_AXIS_PAN], err[VISCA_AXIS_TILT], 0,
+			VISCA_PAN_SPEED_MAX, VISCA_TILT_SPEED_MAX, &pan_speed, &tilt_speed);
+	ready = (m->known & pantilt) == pantilt;
+	// a stop waiting in the queue goes first
+	urgent = c->queues[VISCA_PRIO_SAFETY].head != c->queues[VISCA_PRIO_SAFETY].tail;
+	pthread_mutex_unlock(&c->io_lock);
+	if (!ready || urgent)
+		return 1;
+
+	// tilt up is positive in VISCA units but -1 for visca_drive_packet()
+	pan_dir = pan > 0 ? 1 : pan < 0 ? -1 : 0;
+	tilt_dir = tilt > 0 ? -1 : tilt < 0 ? 1 : 0;
+	zoom_dir = zoom > 0 ? 1 : zoom < 0 ? -1 : 0;
+	if (pan_dir != p->pan_dir || tilt_dir != p->tilt_dir
+		|| (pan_dir && abs(pan) != p->pan_speed) || (tilt_dir && abs(tilt) != p->tilt_speed)) {
+		visca_drive_packet(&packet, pan_dir, tilt_dir, pan_dir ? abs(pan) : 1, tilt_dir ? abs(tilt) : 1);
+		sent = visca_follow_send(c, camera, &packet);
+		// closed meanwhile: detach did not see this drive, stop it here
+		if (!visca_conn_has(c, x)) {
+			visca_follow_stop(c, camera, 1, 0);
+			return 0;
+		}
+		if (sent) {
+			pthread_mutex_lock(&c->io_lock);
+			f->pan_dir = pan_dir;
+			f->tilt_dir = tilt_dir;
+			f->pan_speed = abs(pan);
+			f->tilt_speed = abs(tilt);
+			pthread_mutex_unlock(&c->io_lock);
+		}
+	}
+	if (zoom_dir != p->zoom_dir || (zoom_dir && abs(zoom) != p->zoom_speed)) {
+		visca_follow_zoom_packet(&packet, zoom_dir, abs(zoom));
+		sent = visca_follow_send(c, camera, &packet);
+		if (!visca_conn_has(c, x)) {
+			visca_follow_stop(c, camera, 0, 1);
+			return 0;
+		}
+		if (sent) {
+			pthread_mutex_lock(&c->io_lock);
+			f->zoom_dir = zoom_dir;
+			f->zoom_speed = abs(zoom);
+			pthread_mutex_unlock(&c->io_lock);
+		}
+	}
+	if (park) {
+		_VISCA_init_packet(&packet);
+		_VISCA_append_byte(&packet, VISCA_COMMAND);
+		_VISCA_append_byte(&packet, VISCA_CATEGORY_PAN_TILTER);
+		_VISCA_append_byte(&packet, VISCA_PT_ABSOLUTE_POSITION);
+		_VISCA_append_byte(&packet, pan_speed);
+		_VISCA_append_byte(&packet, tilt_speed);
+		visca_append_nibbles(&packet, (int)lrintf(target[VISCA_AXIS_PAN]));
+		visca_append_nibbles(&packet, (int)lrintf(target[VISCA_AXIS_TILT]));
+		visca_follow_send(c, camera, &packet);
+		if (!visca_conn_has(c, x)) {
+			visca_follow_stop(c, camera, 1, 0);
+			return 0;
+		}
+	}
+	if (park_zoom) {
+		_VISCA_init_packet(&packet);
+		_VISCA_append_byte(&packet, VISCA_COMMAND);
+		_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+		_VISCA_append_byte(&packet, VISCA_ZOOM_VALUE);
+		visca_append_nibbles(&packet, (int)lrintf(target[VISCA_AXIS_ZOOM]));
+		visca_follow_send(c, camera, &packet);
+		if (!visca_conn_has(c, x)) {
+			visca_follow_stop(c, camera, 0, 1);
+			return 0;
+		}
+	}
+	pthread_mutex_lock(&c->io_lock);
+	f->settled = !moving && (e->known & pantilt) == pantilt;
+	pthread_mutex_unlock(&c->io_lock);
+	return 1;
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// World-Space Look-At
+/*-------------------------------------------*/
+/* [look_at( hands the Pd thread's latest world point to the I/O thread,
+ * which turns it into pan/tilt (and zoom) targets for every mounted camera
+ * and streams them like follow mode: queued drives at the rate the target
+ * moves between points plus a gap correction, coalesced per camera with
+ * whatever else is queued. When no point has come for VISCA_LOOK_HOLD_MS
+ * an absolute move parks each camera on the last one.
+ */
+
+// pan/tilt (encoder units) and zoom (with width > 0) aiming a mounted
+// camera at a world point; 0 when the point is the pan/tilt centre (caller
+// holds io_lock)
+static int visca_look_aim(const t_visca_aim *a, const t_visca_estimate *e, const float *point,
+	float width, float *target) {
+	float d[3], f, l, u, dist;
+	int i;
+	for (i = 0; i < 3; i++)
+		d[i] = point[i] - a->origin[i];
+	f = a->axes[0][0] * d[0] + a->axes[0][1] * d[1] + a->axes[0][2] * d[2];
+	l = a->axes[1][0] * d[0] + a->axes[1][1] * d[1] + a->axes[1][2] * d[2];
+	u = a->axes[2][0] * d[0] + a->axes[2][1] * d[1] + a->axes[2][2] * d[2];
+	dist = sqrtf(f * f + l * l + u * u);
+	if (dist <= 0)
+		return 0;
+	// pan is positive to the right, tilt up
+	target[VISCA_AXIS_PAN] = -atan2f(l, f) * 180 / M_PI * e->units_per_degree[VISCA_AXIS_PAN];
+	target[VISCA_AXIS_TILT] = atan2f(u, sqrtf(f * f + l * l)) * 180 / M_PI
+		* e->units_per_degree[VISCA_AXIS_TILT];
+	target[VISCA_AXIS_ZOOM] = width > 0
+		? visca_estimate_fov_zoom(e, 2 * atanf(width / 2 / dist) * 180 / M_PI) : 0;
+	return 1;
+}
+
+static void visca_look_cmd(t_visca_cmd *cmd, t_visca *owner, int camera, int kind,
+	const VISCAPacket_t *packet) {
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->kind = kind;
+	cmd->owner = owner;
+	cmd->camera = camera;
+	cmd->packet = *packet;
+	cmd->prio = visca_cmd_prio(packet);
+	cmd->queued = visca_now_ms();
+}
+
+// is a look-at step due? (caller holds io_lock) otherwise lowers wait
+static int visca_io_look_due(t_visca_conn *c, double now, double *wait) {
+	t_visca_aim *a;
+	int i, busy = 0;
+	for (i = 1; i <= VISCA_MAX_CAMERAS; i++) {
+		a = &c->aims[i];
+		// stop what a finished look-at left moving
+		if (!c->look.owner && (a->sent[VISCA_AXIS_PAN] || a->sent[VISCA_AXIS_TILT]
+			|| a->sent[VISCA_AXIS_ZOOM]))
+			return 1;
+		busy |= a->mounted && a->stamp > 0 && !a->settled;
+	}
+	if (!c->look.owner)
+		return 0;
+	if (c->look.fresh || (busy && now >= c->look.next))
+		return 1;
+	if (busy && (*wait < 0 || c->look.next - now < *wait))
+		*wait = c->look.next - now;
+	return 0;
+}
+
+// one look-at step for every mounted camera, called from the I/O thread
+// with client_lock
+static void visca_look_step(t_visca_conn *c) {
+	t_visca_look look;
+	t_visca_aim *a;
+	t_visca_estimate *e;
+	t_visca_cmd cmds[3 * VISCA_MAX_CAMERAS];
+	VISCAPacket_t packet;
+	float t[VISCA_AXES], rate[VISCA_AXES], pos[VISCA_AXES], err[VISCA_AXES];
+	int halt[VISCA_MAX_CAMERAS + 1];
+	int cam, i, n = 0, resting, late, park, known, pan, tilt, zoom, pan_speed, tilt_speed;
+	const int pantilt = (1 << VISCA_AXIS_PAN) | (1 << VISCA_AXIS_TILT);
+	double now = visca_now_ms(), ahead, dt;
+
+	pthread_mutex_lock(&c->io_lock);
+	look = c->look;
+	c->look.fresh = 0;
+	// a command sent now takes effect about half a round trip later
+	ahead = now + c->rtt / 2;
+	for (cam = 1; cam <= VISCA_MAX_CAMERAS; cam++) {
+		a = &c->aims[cam];
+		e = &c->estimates[cam];
+		halt[cam] = 0;
+		if (!look.owner) {
+			halt[cam] = (a->sent[VISCA_AXIS_PAN] || a->sent[VISCA_AXIS_TILT] ? 1 : 0)
+				| (a->sent[VISCA_AXIS_ZOOM] ? 2 : 0);
+			memset(a->sent, 0, sizeof(a->sent));
+			continue;
+		}
+		if (!a->mounted)
+			continue;
+		if (look.fresh && visca_look_aim(a, e, look.point, look.width, t)) {
+			// the target's rate between points feeds the drive forward
+			dt = look.stamp - a->stamp;
+			a->interval = a->stamp > 0 && dt > 0 && dt < VISCA_LOOK_HOLD_MS ? dt : 0;
+			for (i = 0; i < VISCA_AXES; i++)
+				a->rate[i] = a->interval > 0 ? (t[i] - a->target[i]) * 1000.0 / dt : 0;
+			memcpy(a->target, t, sizeof(t));
+			a->zoom = look.width > 0;
+			a->stamp = look.stamp;
+			a->settled = 0;
+		}
+		if (!a->stamp || a->settled)
+			continue;
+		resting = now - a->stamp > VISCA_LOOK_HOLD_MS;
+		// a point overdue by another interval is aimed at where it was
+		late = now - a->stamp > 2 * a->interval;
+		visca_estimate_at(e, ahead, pos);
+		for (i = 0; i < VISCA_AXES; i++) {
+			rate[i] = late ? 0 : a->rate[i];
+			t[i] = a->target[i] + rate[i] * (ahead - a->stamp) / 1000.0;
+			err[i] = t[i] - pos[i];
+		}
+		t[VISCA_AXIS_ZOOM] = t[VISCA_AXIS_ZOOM] < 0 ? 0
+			: t[VISCA_AXIS_ZOOM] > VISCA_ZOOM_MAX ? VISCA_ZOOM_MAX : t[VISCA_AXIS_ZOOM];
+		known = (e->known & pantilt) == pantilt;
+		// a first point, or the points stopped coming: one absolute move
+		park = resting || !known || a->interval <= 0;
+		pan = tilt = zoom = 0;
+		if (!park) {
+			pan = visca_follow_axis(e->pan_speeds, VISCA_PAN_SPEED_MAX, a->sent[VISCA_AXIS_PAN],
+				rate[VISCA_AXIS_PAN], err[VISCA_AXIS_PAN], VISCA_FOLLOW_DEADBAND);
+			tilt = visca_follow_axis(e->tilt_speeds, VISCA_TILT_SPEED_MAX, a->sent[VISCA_AXIS_TILT],
+				rate[VISCA_AXIS_TILT], err[VISCA_AXIS_TILT], VISCA_FOLLOW_DEADBAND);
+			if (a->zoom)
+				zoom = visca_follow_axis(e->zoom_speeds, VISCA_ZOOM_SPEED_MAX, a->sent[VISCA_AXIS_ZOOM],
+					rate[VISCA_AXIS_ZOOM], err[VISCA_AXIS_ZOOM], VISCA_FOLLOW_ZOOM_DEADBAND);
+		}
+		// tilt up is positive in VISCA units but -1 for visca_drive_packet()
+		if (pan != a->sent[VISCA_AXIS_PAN] || tilt != a->sent[VISCA_AXIS_TILT]) {
+			visca_drive_packet(&packet, pan > 0 ? 1 : pan < 0 ? -1 : 0,
+				tilt > 0 ? -1 : tilt < 0 ? 1 : 0, pan ? abs(pan) : 1, tilt ? abs(tilt) : 1);
+			visca_look_cmd(&cmds[n++], look.owner, cam, VISCA_CMD_DRIVE, &packet);
+			a->sent[VISCA_AXIS_PAN] = pan;
+			a->sent[VISCA_AXIS_TILT] = tilt;
+		}
+		if (zoom != a->sent[VISCA_AXIS_ZOOM]) {
+			visca_follow_zoom_packet(&packet, zoom > 0 ? 1 : zoom < 0 ? -1 : 0, abs(zoom));
+			visca_look_cmd(&cmds[n++], look.owner, cam, VISCA_CMD_ZOOM, &packet);
+			a->sent[VISCA_AXIS_ZOOM] = zoom;
+		}
+		if (!park)
+			continue;
+		if (!known || fabsf(err[VISCA_AXIS_PAN]) > VISCA_FOLLOW_DEADBAND
+			|| fabsf(err[VISCA_AXIS_TILT]) > VISCA_FOLLOW_DEADBAND) {
+			visca_plan_move(e, err[VISCA_AXIS_PAN], err[VISCA_AXIS_TILT], 0,
+				VISCA_PAN_SPEED_MAX, VISCA_TILT_SPEED_MAX, &pan_speed, &tilt_speed);
+			_VISCA_init_packet(&packet);
+			_VISCA_append_byte(&packet, VISCA_COMMAND);
+			_VISCA_append_byte(&packet, VISCA_CATEGORY_PAN_TILTER);
+			_VISCA_append_byte(&packet, VISCA_PT_ABSOLUTE_POSITION);
+			_VISCA_append_byte(&packet, pan_speed);
+			_VISCA_append_byte(&packet, tilt_speed);
+			visca_append_nibbles(&packet, (int)lrintf(t[VISCA_AXIS_PAN]));
+			visca_append_nibbles(&packet, (int)lrintf(t[VISCA_AXIS_TILT]));
+			visca_look_cmd(&cmds[n++], look.owner, cam, VISCA_CMD_PANTILT_ABS, &packet);
+		}
+		if (a->zoom && fabsf(err[VISCA_AXIS_ZOOM]) > VISCA_FOLLOW_ZOOM_DEADBAND) {
+			_VISCA_init_packet(&packet);
+			_VISCA_append_byte(&packet, VISCA_COMMAND);
+			_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+			_VISCA_append_byte(&packet, VISCA_ZOOM_VALUE);
+			visca_append_nibbles(&packet, (int)lrintf(t[VISCA_AXIS_ZOOM]));
+			visca_look_cmd(&cmds[n++], look.owner, cam, VISCA_CMD_ZOOM, &packet);
+		}
+		a->settled = 1;
+	}
+	pthread_mutex_unlock(&c->io_lock);
+
+	for (i = 0; i < n; i++)
+		visca_io_submit(c, &cmds[i]);
+	// look-at ended: stop the heads it left moving directly, there may be
+	// no object left to report to
+	for (cam = 1; cam <= VISCA_MAX_CAMERAS; cam++) {
+		if (halt[cam] & 1) {
+			visca_drive_packet(&packet, 0, 0, 1, 1);
+			visca_follow_send(c, cam, &packet);
+		}
+		if (halt[cam] & 2) {
+			visca_follow_zoom_packet(&packet, 0, 0);
+			visca_follow_send(c, cam, &packet);
+		}
+	}
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// I/O Thread Main Loop
+/*-------------------------------------------*/
+// stop heads the tracker left moving; pick the next due tracking step
+// (caller holds io_lock); returns the client to step, or 0 and the wait
+static t_visca *visca_io_track_due(t_visca_conn *c, double now, double *wait, int *stop) {
+	t_visca *x, *due = 0;
+	int i;
+	*stop = 0;
+	for (i = 0; i < c->nclients; i++) {
+		x = c->clients[i];
+		if (!x->track.on) {
+			x->track.int_x = x->track.int_y = 0;
+			x->track.err_x = x->track.err_y = 0;
+			x->track.acquired = 0;
+			x->track.next = now;
+			// stop a head the tracker was driving
+			if (x->track.pan_dir || x->track.tilt_dir) {
+				*stop = 1;
+				return x;
+			}
+			continue;
+		}
+		if (now >= x->track.next) {
+			if (!due || x->track.next < due->track.next)
+				due = x;
+		} else if (*wait < 0 || x->track.next - now < *wait)
+			*wait = x->track.next - now;
+	}
+	return due;
+}
+
+// pick the next due follow step, or a slave a follow left moving (caller
+// holds io_lock); returns the client, or 0 and the wait
+static t_visca *visca_io_follow_due(t_visca_conn *c, double now, double *wait, int *stop) {
+	t_visca *x, *due = 0;
+	int i;
+	*stop = 0;
+	for (i = 0; i < c->nclients; i++) {
+		x = c->clients[i];
+		if (!x->follow.master) {
+			x->follow.next = now;
+			if (x->follow.pan_dir || x->follow.tilt_dir || x->follow.zoom_dir) {
+				*stop = 1;
+				return x;
+			}
+			continue;
+		}
+		if (now >= x->follow.next) {
+			if (!due || x->follow.next < due->follow.next)
+				due = x;
+		} else if (*wait < 0 || x->follow.next - now < *wait)
+			*wait = x->follow.next - now;
+	}
+	return due;
+}
+
+// the timed command due first (caller holds io_lock), or -1
+static int visca_io_timed_next(t_visca_conn *c) {
+	int i, first = -1;
+	for (i = 0; i < c->ntimed; i++)
+		if (first < 0 || c->timed[i].at < c->timed[first].at)
+			first = i;
+	return first;
+}
+
+// how long a transaction started now may keep the link: an inquiry and its
+// answer on the wire plus the camera's turnaround (caller holds io_lock)
+static double visca_io_span(const t_visca_conn *c) {
+	return (VISCA_INQ_REPLY_BYTES + 6) * VISCA_BYTE_MS + c->rtt;
+}
+
+// hold a timed command until its instant, then send it and report how late
+// it went (caller holds client_lock); a stop queued meanwhile goes first,
+// from here, so the command keeps its place
+static void visca_io_release(t_visca_conn *c, t_visca_cmd *cmd) {
+	t_visca_queue *q = &c->queues[VISCA_PRIO_SAFETY];
+	t_visca_cmd halt;
+	float out[1];
+	double left;
+	int stop, cancel, i;
+#ifdef VISCA_POSIX
+	struct timespec ts;
+#endif
+	while ((left = cmd->at - visca_now_ms()) > 2) {
+		pthread_mutex_lock(&c->io_lock);
+		// a stop for this camera cancels timed motion as it does queued
+		for (cancel = 0, i = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE)
+			if (q->cmds[i].camera == cmd->camera && cmd->prio == VISCA_PRIO_MOTION
+				&& (visca_cmd_axes(&q->cmds[i].packet) & visca_cmd_axes(&cmd->packet)))
+				cancel = 1;
+		stop = !cancel && visca_io_next(c, visca_now_ms(), 1, &halt);
+		pthread_mutex_unlock(&c->io_lock);
+		if (cancel)
+			return;
+		if (stop) {
+			visca_io_send(c, &halt);
+			if (!visca_conn_has(c, cmd->owner))
+				return;
+			continue;
+		}
+		// sp_wait() treats 0 as forever
+		pthread_mutex_unlock(&c->client_lock);
+		sp_wait(c->io_events, (unsigned int)ceil(left - 2));
+		pthread_mutex_lock(&c->client_lock);
+		// its object closed meanwhile: purged with the rest
+		if (!visca_conn_has(c, cmd->owner))
+			return;
+	}
+#ifdef VISCA_POSIX
+	// the last stretch on the precise timer
+	ts.tv_sec = (time_t)(cmd->at / 1000.0);
+	ts.tv_nsec = (long)((cmd->at - ts.tv_sec * 1000.0) * 1000000.0);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+		;
+#endif
+	while ((left = cmd->at - visca_now_ms()) > 0)
+		VISCA_usleep(left > 2 ? (uint32_t)(left - 1) * 1000 : 100);
+	cmd->queued = cmd->at;
+	if (cmd->kind == VISCA_CMD_CUE)
+		visca_cue_fire(c, cmd);
+	else
+		visca_io_send(c, cmd);
+	// lateness of the write itself, not of the wakeup before it
+	out[0] = cmd->sent - cmd->at;
+	visca_post_event(cmd->owner, s_jitter, 1, out);
+}
+
+// pick up completions of commands that returned at their ACK (caller
+// holds client_lock)
+static void visca_io_collect(t_visca_conn *c) {
+	VISCACompletion_t done;
+	int alive = 1;
+#ifdef VISCA_POSIX
+	struct pollfd pfd;
+#endif
+	pthread_mutex_lock(&c->iface_lock);
+	for (;;) {
+		// those read along with other replies first, then what is waiting
+		if (VISCA_get_completion(&c->iface, &done, 0) != VISCA_SUCCESS) {
+#ifdef VISCA_POSIX
+			pfd.fd = c->iface.port_fd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, 0) <= 0)
+				break;
+			if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+				alive = 0;
+				break;
+			}
+			if (VISCA_get_completion(&c->iface, &done, 1) != VISCA_SUCCESS) {
+				if (!visca_port_alive(c)) {
+					alive = 0;
+					break;
+				}
+				continue;
+			}
+#else
+			break;
+#endif
+		}
+		// a reply nothing waits for (a late ACK, a completion of a
+		// command that timed out) has no one to hand it to
+		if (done.type != VISCA_RESPONSE_COMPLETED
+			&& done.type != VISCA_RESPONSE_ERROR)
+			continue;
+		if (done.address < 1 || done.address > VISCA_MAX_CAMERAS
+			|| done.socket < 1 || done.socket > VISCA_SOCKETS)
+			continue;
+		pthread_mutex_unlock(&c->iface_lock);
+		visca_io_finish(c, done.address, done.socket,
+			done.type == VISCA_RESPONSE_COMPLETED ? 0 : done.error);
+		pthread_mutex_lock(&c->iface_lock);
+	}
+	pthread_mutex_unlock(&c->iface_lock);
+	if (!alive)
+		visca_link_down(c);
+}
+
+// a pan/tilt move whose completion is overdue (the camera never sent
+// it): ask the pan/tilt status instead (caller holds
+// client_lock)
+static void visca_io_check(t_visca_conn *c, double now) {
+	t_visca_running *r;
+	uint16_t mode;
+	uint32_t err;
+	t_symbol *name;
+	int camera, socket, status, alive = 1;
+	for (camera = 1; alive && camera <= VISCA_MAX_CAMERAS; camera++)
+		for (socket = 1; alive && socket <= VISCA_SOCKETS; socket++) {
+			pthread_mutex_lock(&c->io_lock);
+			r = &c->running[camera][socket];
+			name = r->on ? visca_done_name(r->cmd.packet.bytes) : 0;
+			if (name != s_pantilt && name != s_home && name != s_reset && name != s_preset)
+				name = 0;
+			if (name && now - r->checked >= VISCA_DONE_CHECK_MS)
+				r->checked = now;
+			else
+				name = 0;
+			pthread_mutex_unlock(&c->io_lock);
+			if (!name)
+				continue;
+			visca_wire_lock(c);
+			err = VISCA_get_pantilt_mode(&c->iface, &c->cameras[camera], &mode);
+			alive = err == VISCA_SUCCESS || visca_port_alive(c);
+			if ((c->iface.type & 0xF0) != VISCA_RESPONSE_COMPLETED)
+				err = VISCA_FAILURE;
+			visca_wire_unlock(c);
+			if (err != VISCA_SUCCESS)
+				continue;
+			status = VISCA_PT_STATUS(mode);
+			if (status != VISCA_PT_STATUS_MOVING)
+				visca_io_finish(c, camera, socket,
+					status == VISCA_PT_STATUS_FAILED ? VISCA_ERROR_CMD_NOT_EXECUTABLE : 0);
+		}
+	if (!alive)
+		visca_link_down(c);
+}
+
+static void *visca_io_main(void *arg) {
+	t_visca_conn *c = (t_visca_conn *)arg;
+	t_visca *x;
+	t_visca_track p;
+	t_visca_follow fp;
+	t_visca_cmd cmd;
+	double now, wait, period, next_rescan = 0;
+	int stop, hold, i;
+
+	pthread_mutex_lock(&c->client_lock);
+	pthread_mutex_lock(&c->io_lock);
+	while (!c->io_quit) {
+		pthread_mutex_unlock(&c->io_lock);
+		now = visca_now_ms();
+		// a reconnect runs the handshake: no client data is needed for it
+		pthread_mutex_unlock(&c->client_lock);
+		visca_link_supervise(c, now, &next_rescan);
+		pthread_mutex_lock(&c->client_lock);
+		pthread_mutex_lock(&c->io_lock);
+		wait = -1;
+
+		// a timed command keeps the link to itself from shortly before its
+		// instant, so nothing slow can be in flight when it is due; what
+		// could still be running then does not start
+		hold = 0;
+		if (c->link_up && (i = visca_io_timed_next(c)) >= 0) {
+			if (c->timed[i].at - now <= VISCA_AT_GUARD_MS) {
+				cmd = c->timed[i];
+				c->timed[i] = c->timed[--c->ntimed];
+				pthread_mutex_unlock(&c->io_lock);
+				visca_io_release(c, &cmd);
+				pthread_mutex_lock(&c->io_lock);
+				continue;
+			}
+			wait = c->timed[i].at - VISCA_AT_GUARD_MS - now;
+			hold = wait <= visca_io_span(c);
+		}
+
+		// completions of commands that returned at their ACK
+		if (c->link_up && c->nrunning > 0) {
+			pthread_mutex_unlock(&c->io_lock);
+			visca_io_collect(c);
+			visca_io_check(c, now);
+			pthread_mutex_lock(&c->io_lock);
+			if (wait < 0 || wait > VISCA_POLL_MS)
+				wait = VISCA_POLL_MS;
+		}
+
+		// queued commands first, highest class first, replayed in order once
+		// the link is back; motion returns at its ACK, so a stop submitted
+		// meanwhile waits at most for an ACK or an inquiry reply
+		if (c->link_up && visca_io_next(c, now, hold, &cmd)) {
+			pthread_mutex_unlock(&c->io_lock);
+			if (cmd.kind == VISCA_CMD_CUE)
+				visca_cue_fire(c, &cmd);
+			else
+				visca_io_send(c, &cmd);
+			pthread_mutex_lock(&c->io_lock);
+			continue;
+		}
+
+		if (c->link_up && (x = visca_io_track_due(c, now, &wait, &stop)) && (stop || !hold)) {
+			p = x->track;
+			pthread_mutex_unlock(&c->io_lock);
+			if (stop) {
+				i = x->address;
+				visca_wire_lock(c);
+				visca_drive(c, i, 0, 0, 1, 1);
+				visca_wire_unlock(c);
+				pthread_mutex_lock(&c->io_lock);
+				if (visca_conn_has(c, x))
+					x->track.pan_dir = x->track.tilt_dir = 0;
+				visca_estimate_pantilt(&c->estimates[i], visca_now_ms(), 0, 0, 1, 1);
+				continue;
+			}
+			period = visca_track_period(&p);
+			i = visca_track_step(x, &p, period / 1000.0);
+			pthread_mutex_lock(&c->io_lock);
+			if (i) {
+				x->track.next += period;
+				if (x->track.next < visca_now_ms())
+					x->track.next = visca_now_ms();
+			}
+			continue;
+		}
+
+		if (c->link_up && (x = visca_io_follow_due(c, now, &wait, &stop)) && (stop || !hold)) {
+			fp = x->follow;
+			pthread_mutex_unlock(&c->io_lock);
+			i = stop ? visca_follow_halt(x) : visca_follow_step(x, &fp);
+			pthread_mutex_lock(&c->io_lock);
+			if (i) {
+				x->follow.next += VISCA_FOLLOW_MS;
+				if (x->follow.next < visca_now_ms())
+					x->follow.next = visca_now_ms();
+			}
+			continue;
+		}
+
+		if (c->link_up && !hold && visca_io_look_due(c, now, &wait)) {
+			pthread_mutex_unlock(&c->io_lock);
+			visca_look_step(c);
+			pthread_mutex_lock(&c->io_lock);
+			c->look.next = visca_now_ms() + VISCA_FOLLOW_MS;
+			continue;
+		}
+
+		// hotplug events and new work wake the wait; reconnects are retried
+		if (!c->link_up) {
+			period = next_rescan > now ? next_rescan - now : 0;
+			if (wait < 0 || wait > period)
+				wait = period;
+		}
+		pthread_mutex_unlock(&c->io_lock);
+		// objects detach while the thread is idle
+		pthread_mutex_unlock(&c->client_lock);
+		// sp_wait() takes whole ms and treats 0 as forever
+		sp_wait(c->io_events, wait < 0 ? 0 : wait < 1 ? 1 : (unsigned int)ceil(wait));
+		pthread_mutex_lock(&c->client_lock);
+		pthread_mutex_lock(&c->io_lock);
+	}
+	// stops queued as the last object left still go out
+	while (c->link_up && visca_io_next(c, visca_now_ms(), 1, &cmd)) {
+		pthread_mutex_unlock(&c->io_lock);
+		visca_io_send(c, &cmd);
+		pthread_mutex_lock(&c->io_lock);
+	}
+	pthread_mutex_unlock(&c->io_lock);
+	pthread_mutex_unlock(&c->client_lock);
+	return 0;
+}
+
+static int visca_io_start(t_visca_conn *c) {
+	c->io_quit = 0;
+	c->link_up = 1;
+	if (sp_new_event_set(&c->io_events) != SP_OK)
+		return 0;
+	// hotplug is optional: without it I/O errors trigger rescans
+	if (sp_new_hotplug_monitor(&c->hotplug) != SP_OK)
+		c->hotplug = 0;
+	else if (sp_add_hotplug_events(c->io_events, c->hotplug) != SP_OK) {
+		sp_free_hotplug_monitor(c->hotplug);
+		c->hotplug = 0;
+	}
+	if (pthread_create(&c->io_thread, 0, visca_io_main, c) != 0) {
+		if (c->hotplug)
+			sp_free_hotplug_monitor(c->hotplug);
+		c->hotplug = 0;
+		sp_free_event_set(c->io_events);
+		c->io_events = 0;
+		return 0;
+	}
+	c->io_running = 1;
+	return 1;
+}
+
+static void visca_io_stop(t_visca_conn *c) {
+	if (!c->io_running)
+		return;
+	pthread_mutex_lock(&c->io_lock);
+	c->io_quit = 1;
+	pthread_mutex_unlock(&c->io_lock);
+	sp_event_set_wakeup(c->io_events);
+	pthread_join(c->io_thread, 0);
+	c->io_running = 0;
+	if (c->hotplug)
+		sp_free_hotplug_monitor(c->hotplug);
+	c->hotplug = 0;
+	sp_free_event_set(c->io_events);
+	c->io_events = 0;
+	memset(c->queues, 0, sizeof(c->queues));
+	c->ntimed = 0;
+}
+
+// wake the I/O thread after changing its parameters
+static void visca_io_kick(t_visca *x) {
+	if (x->conn)
+		sp_event_set_wakeup(x->conn->io_events);
+}
+
+// tracking parameters are read by the I/O thread while connected
+static void visca_params_lock(t_visca *x) {
+	if (x->conn)
+		pthread_mutex_lock(&x->conn->io_lock);
+}
+
+static void visca_params_unlock(t_visca *x) {
+	if (x->conn)
+		pthread_mutex_unlock(&x->conn->io_lock);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Enumerate Com Devices (uses libserialport)
+/*-------------------------------------------*/
+/* sp_list_ports() walks sysfs and reads the USB descriptors of every tty,
+ * which can stall the scheduler for a long time on busy machines. One
+ * background thread, shared by all [visca] objects, enumerates into a
+ * cache. Hotplug notifications invalidate it; where they are not
+ * supported the cache simply expires. [devices( answers from the cache
+ * and only waits (on a clock, never blocking) while a scan is running.
+ */
+#define VISCA_DEVICES_TTL_MS 2000
+
+typedef struct _visca_devinfo {
+	char name[128];
+	char description[128];
+	char serial[64];
+	int vid, pid;
+} t_visca_devinfo;
+
+static struct {
+	pthread_mutex_t lock;
+	struct sp_event_set *events;   // hotplug + wakeup
+	int started;
+	int watching;   // hotplug notifications keep the cache fresh
+	int dirty;      // a scan is needed or running
+	double stamp;   // when the last scan finished
+	t_visca_devinfo *devs;
+	int ndevs;
+} visca_devcache = {
+	PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 1, 0, 0, 0
+};
+
+// one full sp_list_ports() pass; returns the number of entries or -1
+static int visca_devcache_scan(t_visca_devinfo **devs) {
+	struct sp_port **ports;
+	t_visca_devinfo *d;
+	const char *str;
+	int i, n;
+
+	*devs = 0;
+	if (sp_list_ports(&ports) != SP_OK)
+		return -1;
+	for (n = 0; ports[n]; n++)
+		;
+	if (n && !(*devs = (t_visca_devinfo *)calloc(n, sizeof(t_visca_devinfo)))) {
+		sp_free_port_list(ports);
+		return -1;
+	}
+	for (i = 0; i < n; i++) {
+		d = &(*devs)[i];
+		snprintf(d->name, sizeof(d->name), "%s", sp_get_port_name(ports[i]));
+		str = sp_get_port_description(ports[i]);
+		snprintf(d->description, sizeof(d->description), "%s", str ? str : "-");
+		str = sp_get_port_usb_serial(ports[i]);
+		snprintf(d->serial, sizeof(d->serial), "%s", str && *str ? str : "-");
+		if (sp_get_port_usb_vid_pid(ports[i], &d->vid, &d->pid) != SP_OK)
+			d->vid = d->pid = 0;
+	}
+	sp_free_port_list(ports);
+	return n;
+}
+
+static void *visca_devcache_main(void *arg) {
+	struct sp_event_set *events = visca_devcache.events;
+	struct sp_hotplug *hotplug = 0;
+	enum sp_hotplug_event ev;
+	char name[256];
+	t_visca_devinfo *devs;
+	int n, ok;
+
+	if (sp_new_hotplug_monitor(&hotplug) == SP_OK
+		&& sp_add_hotplug_events(events, hotplug) != SP_OK) {
+		sp_free_hotplug_monitor(hotplug);
+		hotplug = 0;
+	}
+
+	pthread_mutex_lock(&visca_devcache.lock);
+	visca_devcache.watching = hotplug != 0;
+	for (;;) {
+		if (visca_devcache.dirty) {
+			pthread_mutex_unlock(&visca_devcache.lock);
+			n = visca_devcache_scan(&devs);
+			pthread_mutex_lock(&visca_devcache.lock);
+			if (n >= 0) {
+				free(visca_devcache.devs);
+				visca_devcache.devs = devs;
+				visca_devcache.ndevs = n;
+			}
+			visca_devcache.dirty = 0;
+			visca_devcache.stamp = visca_now_ms();
+			continue;
+		}
+		pthread_mutex_unlock(&visca_devcache.lock);
+		ok = sp_wait(events, 0) == SP_OK;
+		pthread_mutex_lock(&visca_devcache.lock);
+		if (!ok)
+			break;
+		while (hotplug && sp_read_hotplug_event(hotplug, &ev, name, sizeof(name)) == SP_OK
+			&& ev != SP_HOTPLUG_NONE)
+			visca_devcache.dirty = 1;
+	}
+	// the next request starts a fresh scanner
+	visca_devcache.started = 0;
+	visca_devcache.watching = 0;
+	visca_devcache.events = 0;
+	pthread_mutex_unlock(&visca_devcache.lock);
+	if (hotplug)
+		sp_free_hotplug_monitor(hotplug);
+	sp_free_event_set(events);
+	return 0;
+}
+
+// start the scanner on first use and expire the cache when nothing watches it
+static void visca_devcache_request(t_visca *x) {
+	pthread_t thread;
+	pthread_mutex_lock(&visca_devcache.lock);
+	if (!visca_devcache.started && sp_new_event_set(&visca_devcache.events) == SP_OK) {
+		if (pthread_create(&thread, 0, visca_devcache_main, 0) == 0) {
+			pthread_detach(thread);
+			visca_devcache.started = 1;
+		} else {
+			sp_free_event_set(visca_devcache.events);
+			visca_devcache.events = 0;
+		}
+	}
+	if (!visca_devcache.started)
+		pd_error(x, "[visca]: unable to start device scanner");
+	else if (!visca_devcache.watching && !visca_devcache.dirty
+		&& visca_now_ms() - visca_devcache.stamp > VISCA_DEVICES_TTL_MS) {
+		visca_devcache.dirty = 1;
+		sp_event_set_wakeup(visca_devcache.events);
+	}
+	pthread_mutex_unlock(&visca_devcache.lock);
+}
+
+// output the cached list if it is current; returns 0 while a scan is running
+static int visca_devices_output(t_visca *x) {
+	t_visca_devinfo *devs = 0;
+	t_atom out[6];
+	int i, n;
+
+	pthread_mutex_lock(&visca_devcache.lock);
+	if (visca_devcache.dirty) {
+		pthread_mutex_unlock(&visca_devcache.lock);
+		return 0;
+	}
+	// copy out: the outlet may call back into [devices(
+	n = visca_devcache.ndevs;
+	if (n && (devs = (t_visca_devinfo *)malloc(n * sizeof(t_visca_devinfo))))
+		memcpy(devs, visca_devcache.devs, n * sizeof(t_visca_devinfo));
+	else
+		n = 0;
+	pthread_mutex_unlock(&visca_devcache.lock);
+
+	// [device index name vid pid serial description( per port, then [devices count(
+	for (i = 0; i < n; i++) {
+		SETFLOAT(&out[0], i);
+		SETSYMBOL(&out[1], gensym(devs[i].name));
+		SETFLOAT(&out[2], devs[i].vid);
+		SETFLOAT(&out[3], devs[i].pid);
+		SETSYMBOL(&out[4], gensym(devs[i].serial));
+		SETSYMBOL(&out[5], gensym(devs[i].description));
+		outlet_anything(x->data_out, gensym("device"), 6, out);
+	}
+	free(devs);
+	SETFLOAT(&out[0], n);
+	outlet_anything(x->data_out, gensym("devices"), 1, out);
+	return 1;
+}
+
+static void visca_devices_tick(t_visca *x) {
+	if (!visca_devices_output(x))
+		clock_delay(x->devices_clock, VISCA_POLL_MS);
+}
+
+// [devices( lists the serial ports on the data outlet
+static void visca_lstdevs(t_visca *x) {
+	visca_devcache_request(x);
+	clock_unset(x->devices_clock);
+	visca_devices_tick(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Queued Commands
+/*-------------------------------------------*/
+// focus tracking: a direct zoom position becomes the combined zoom and
+// focus packet, the focus taken from the camera's curve
+static void visca_focus_follow(t_visca *x, VISCAPacket_t *packet) {
+	const unsigned char *b = packet->bytes + 1;
+	int focus;
+	if (packet->length != 8 || b[0] != VISCA_COMMAND || b[1] != VISCA_CATEGORY_CAMERA1
+		|| b[2] != VISCA_ZOOM_FOCUS_VALUE)
+		return;
+	pthread_mutex_lock(&x->conn->io_lock);
+	focus = visca_estimate_focus(&x->conn->estimates[x->address], visca_nibbles(b + 3));
+	pthread_mutex_unlock(&x->conn->io_lock);
+	if (focus >= 0)
+		visca_append_nibbles(packet, focus);
+}
+
+// queue a packet for this object's camera in the class it belongs to;
+// inquiries carry a deadline after which they are dropped as stale
+static void visca_submit(t_visca *x, const char *what, int kind, const VISCAPacket_t *packet) {
+	t_visca_cmd cmd;
+	if (!x->conn) {
+		pd_error(x, "[visca]: %s: open a serial port first", what);
+		return;
+	}
+	// nothing past the packet's length is left over from earlier use
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.kind = kind;
+	cmd.owner = x;
+	cmd.camera = x->address;
+	memcpy(cmd.packet.bytes, packet->bytes, packet->length);
+	cmd.packet.length = packet->length;
+	if (x->focus_track)
+		visca_focus_follow(x, &cmd.packet);
+	cmd.prio = visca_cmd_prio(packet);
+	cmd.queued = visca_now_ms();
+	cmd.at = x->at;
+	cmd.deadline = cmd.prio == VISCA_PRIO_INQUIRY && x->deadline > 0
+		? cmd.queued + x->deadline : 0;
+	if (!visca_io_submit(x->conn, &cmd))
+		pd_error(x, "[visca]: command queue full");
+}
+
+// [deadline ms( how long an inquiry may wait in the queue, 0 forever
+void visca_deadline(t_visca *x, t_floatarg f) {
+	x->deadline = f > 0 ? f : 0;
+}
+
+// [weight w( this camera's share of the link relative to the others on the chain
+void visca_weight(t_visca *x, t_floatarg f) {
+	if (!x->conn) {
+		pd_error(x, "[visca]: weight: open a serial port first");
+		return;
+	}
+	pthread_mutex_lock(&x->conn->io_lock);
+	x->conn->shares[x->address].weight = f < 0.1 ? 0.1 : f;
+	pthread_mutex_unlock(&x->conn->io_lock);
+}
+
+// [stats( one [stats camera weight queued sent expired bytes wait_avg wait_max(
+// per camera on the chain; waits in ms
+void visca_stats(t_visca *x) {
+	t_visca_share shares[VISCA_MAX_CAMERAS + 1];
+	int queued[VISCA_MAX_CAMERAS + 1] = {0};
+	t_atom out[8];
+	t_visca_queue *q;
+	int cam, prio, i, ncameras;
+	if (!x->conn) {
+		pd_error(x, "[visca]: stats: open a serial port first");
+		return;
+	}
+	pthread_mutex_lock(&x->conn->io_lock);
+	memcpy(shares, x->conn->shares, sizeof(shares));
+	for (prio = 0; prio < VISCA_PRIO_CLASSES; prio++) {
+		q = &x->conn->queues[prio];
+		for (i = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE)
+			queued[q->cmds[i].camera]++;
+	}
+	ncameras = x->conn->ncameras;
+	pthread_mutex_unlock(&x->conn->io_lock);
+	for (cam = 1; cam <= ncameras; cam++) {
+		SETFLOAT(&out[0], cam);
+		SETFLOAT(&out[1], shares[cam].weight);
+		SETFLOAT(&out[2], queued[cam]);
+		SETFLOAT(&out[3], shares[cam].sent);
+		SETFLOAT(&out[4], shares[cam].expired);
+		SETFLOAT(&out[5], shares[cam].bytes);
+		SETFLOAT(&out[6], shares[cam].sent ? shares[cam].wait_sum / shares[cam].sent : 0);
+		SETFLOAT(&out[7], shares[cam].wait_max);
+		outlet_anything(x->data_out, gensym("stats"), 8, out);
+	}
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Pan/Tilt Drive
+/*-------------------------------------------*/
+// [drive pan tilt( signed speed indices (pan >0 right, tilt >0 up), 0 stops
+// the axis. Queued through the I/O thread; only the latest drive is kept.
+void visca_drive_method(t_visca *x, t_floatarg pan, t_floatarg tilt) {
+	VISCAPacket_t packet;
+	int p = (int)pan, t = (int)tilt;
+	visca_drive_packet(&packet, p < 0 ? -1 : p > 0, t > 0 ? -1 : t < 0,
+		p < 0 ? -p : p, t < 0 ? -t : t);
+	visca_submit(x, "drive", VISCA_CMD_DRIVE, &packet);
+}
+
+// [drive_fov pan tilt( joystick drive in -1..1 that keeps the picture moving
+// at the same rate whatever the zoom: full deflection sweeps fov_rate frame
+// widths per second. The field of view comes from the estimated zoom, so
+// nothing is asked of the camera.
+void visca_drive_fov(t_visca *x, t_floatarg pan, t_floatarg tilt) {
+	VISCAPacket_t packet;
+	t_visca_estimate *e;
+	float pos[VISCA_AXES], deg;
+	int p = 0, t = 0;
+	if (!x->conn) {
+		pd_error(x, "[visca]: drive_fov: open a serial port first");
+		return;
+	}
+	pan = pan < -1 ? -1 : pan > 1 ? 1 : pan;
+	tilt = tilt < -1 ? -1 : tilt > 1 ? 1 : tilt;
+	e = &x->conn->estimates[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	visca_estimate_at(e, visca_now_ms(), pos);
+	deg = visca_estimate_fov(e, pos[VISCA_AXIS_ZOOM]) * x->fov_rate;
+	if (pan != 0)
+		p = visca_speed_index(e->pan_speeds, VISCA_PAN_SPEED_MAX,
+			fabsf(pan) * deg * e->units_per_degree[VISCA_AXIS_PAN]);
+	if (tilt != 0)
+		t = visca_speed_index(e->tilt_speeds, VISCA_TILT_SPEED_MAX,
+			fabsf(tilt) * deg * e->units_per_degree[VISCA_AXIS_TILT]);
+	pthread_mutex_unlock(&x->conn->io_lock);
+	visca_drive_packet(&packet, pan < 0 ? -1 : pan > 0, tilt > 0 ? -1 : tilt < 0,
+		p ? p : 1, t ? t : 1);
+	visca_submit(x, "drive_fov", VISCA_CMD_DRIVE, &packet);
+}
+
+// [fov_rate r( frame widths per second at full [drive_fov( deflection
+void visca_fov_rate(t_visca *x, t_floatarg f) {
+	x->fov_rate = f > 0 ? f : 0;
+}
+
+// [fov_table d0 d1 ...( this camera's horizontal field of view in degrees
+// from full wide to full tele, at evenly spaced zoom positions
+void visca_fov_table(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_estimate *e;
+	int i;
+	if (!x->conn) {
+		pd_error(x, "[visca]: fov_table: open a serial port first");
+		return;
+	}
+	if (argc != VISCA_FOV_POINTS) {
+		pd_error(x, "[visca]: fov_table: %d values, wide to tele", VISCA_FOV_POINTS);
+		return;
+	}
+	e = &x->conn->estimates[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	for (i = 0; i < VISCA_FOV_POINTS; i++)
+		e->fov[i] = atom_getfloatarg(i, argc, argv);
+	pthread_mutex_unlock(&x->conn->io_lock);
+}
+
+// [stop( halts pan/tilt ahead of anything queued and ends host tracking
+// and following
+void visca_stop(t_visca *x) {
+	VISCAPacket_t packet;
+	visca_params_lock(x);
+	x->track.on = 0;
+	x->follow.master = 0;
+	visca_params_unlock(x);
+	visca_drive_packet(&packet, 0, 0, 1, 1);
+	visca_submit(x, "stop", VISCA_CMD_DRIVE, &packet);
+}
+
+// [position( asks for the pan/tilt position, reported as [position pan tilt(
+void visca_position(t_visca *x) {
+	VISCAPacket_t packet;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_INQUIRY);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_PAN_TILTER);
+	_VISCA_append_byte(&packet, VISCA_PT_POSITION_INQ);
+	visca_submit(x, "position", VISCA_CMD_PANTILT_POS, &packet);
+}
+/*-------------------------------------------*/
+
 
-static t_class *visca_class;
+/*-------------------------------------------*/
+// Zoom Drive
+/*-------------------------------------------*/
+// [zoom_drive s( signed zoom speed 1-7 (>0 tele, <0 wide), 0 stops
+void visca_zoom_drive(t_visca *x, t_floatarg f) {
+	VISCAPacket_t packet;
+	int speed = (int)f;
+	if (speed > VISCA_ZOOM_SPEED_MAX) speed = VISCA_ZOOM_SPEED_MAX;
+	if (speed < -VISCA_ZOOM_SPEED_MAX) speed = -VISCA_ZOOM_SPEED_MAX;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_COMMAND);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(&packet, VISCA_ZOOM);
+	_VISCA_append_byte(&packet, speed > 0 ? VISCA_ZOOM_TELE_SPEED | speed
+		: speed < 0 ? VISCA_ZOOM_WIDE_SPEED | -speed : VISCA_ZOOM_STOP);
+	visca_submit(x, "zoom_drive", VISCA_CMD_ZOOM, &packet);
+}
 
-typedef struct _visca {
-	t_object x_obj;
-	t_outlet *bang_out;
-	t_outlet *float_out;
-	/*Structures needed for the VISCA library*/
-	VISCAInterface_t iface;
-	VISCACamera_t camera;
-} t_visca;
+// [zoom_value( asks for the zoom position, reported as [zoom value(
+void visca_zoom_value(t_visca *x) {
+	VISCAPacket_t packet;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_INQUIRY);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(&packet, VISCA_ZOOM_VALUE);
+	visca_submit(x, "zoom_value", VISCA_CMD_ZOOM_POS, &packet);
+}
+
+// [zoom_to z( direct zoom position 0-16384 (0x4000), coalesced per camera
+void visca_zoom_to(t_visca *x, t_floatarg f) {
+	VISCAPacket_t packet;
+	int zoom = (int)f;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_COMMAND);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(&packet, VISCA_ZOOM_VALUE);
+	visca_append_nibbles(&packet, zoom < 0 ? 0 : zoom > VISCA_ZOOM_MAX ? VISCA_ZOOM_MAX : zoom);
+	visca_submit(x, "zoom_to", VISCA_CMD_ZOOM, &packet);
+}
+/*-------------------------------------------*/
 
 
 /*-------------------------------------------*/
-// Print Object usage
+// Focus Tracking
 /*-------------------------------------------*/
-void visca_print_usage_bang() {
-	post("Usage: visca-cli [-d <serial port device>] command\n");
-	post("  default serial port device: \n");      
-	post("  for available commands see sourcecode...\n"); 
+/* With manual focus, a zoom move throws the picture out of focus unless
+ * focus follows. Each camera keeps a zoom->focus curve, learned point by
+ * point for a lens setup or loaded with a profile. While [focus_track 1(
+ * is on, every direct zoom position this object sends goes out as one
+ * combined zoom and focus packet (VISCA_set_zoom_and_focus_value's layout)
+ * with the focus read off the curve: one command per lens move instead of
+ * two, and no autofocus hunting.
+ */
+
+// [focus_track 1( switches to manual focus and lets focus follow zoom
+void visca_focus_track(t_visca *x, t_floatarg f) {
+	VISCAPacket_t packet;
+	x->focus_track = (f != 0);
+	if (!x->focus_track)
+		return;
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_COMMAND);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(&packet, VISCA_FOCUS_AUTO);
+	_VISCA_append_byte(&packet, VISCA_FOCUS_AUTO_OFF);
+	visca_submit(x, "focus_track", VISCA_CMD_OTHER, &packet);
+}
+
+// [focus_learn( adds the current zoom and focus as a curve point, answered
+// with [focus_point zoom focus points(; focus by hand at a few zoom
+// positions first
+void visca_focus_learn(t_visca *x) {
+	VISCAPacket_t packet;
+	visca_zoom_value(x);
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_INQUIRY);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_CAMERA1);
+	_VISCA_append_byte(&packet, VISCA_FOCUS_VALUE);
+	visca_submit(x, "focus_learn", VISCA_CMD_FOCUS_LEARN, &packet);
+}
+
+// [focus_curve z f z f ...( replaces the camera's curve; [focus_curve(
+// outputs it the same way, to be kept with the lens setup
+void visca_focus_curve(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_estimate *e;
+	t_atom out[2 * VISCA_FOCUS_POINTS];
+	int i, n;
+	if (!x->conn) {
+		pd_error(x, "[visca]: focus_curve: open a serial port first");
+		return;
+	}
+	e = &x->conn->estimates[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	if (argc) {
+		e->nfocus = 0;
+		for (i = 0; i + 1 < argc; i += 2)
+			visca_estimate_focus_point(e, atom_getfloatarg(i, argc, argv),
+				atom_getfloatarg(i + 1, argc, argv));
+	}
+	for (i = 0; i < e->nfocus; i++) {
+		SETFLOAT(&out[2 * i], e->focus_zoom[i]);
+		SETFLOAT(&out[2 * i + 1], e->focus_value[i]);
+	}
+	n = 2 * e->nfocus;
+	pthread_mutex_unlock(&x->conn->io_lock);
+	if (!argc)
+		outlet_anything(x->data_out, s, n, out);
+}
+
+// [focus_clear( forgets the camera's curve
+void visca_focus_clear(t_visca *x) {
+	if (!x->conn)
+		return;
+	pthread_mutex_lock(&x->conn->io_lock);
+	x->conn->estimates[x->address].nfocus = 0;
+	pthread_mutex_unlock(&x->conn->io_lock);
 }
 /*-------------------------------------------*/
 
 
 /*-------------------------------------------*/
-// Print Object info
+// Raw Messages
 /*-------------------------------------------*/
-void visca_info(){
-	post("This object written to control PTZ cameras using Visca protocol. \n"
-		"Supports Sony D70/D30.\n"
-		"megrimm 2019\n");
+// [raw byte...( queues a message body for this camera (header and
+// terminator are added) in the class its bytes put it in; the reply comes
+// back as [raw byte...(. Bytes are numbers or symbols like 0x81.
+void visca_raw(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	VISCAPacket_t packet;
+	long v;
+	int i;
+	if (argc < 1 || argc > (int)sizeof(packet.bytes) - 2) {
+		pd_error(x, "[visca]: raw: 1 to %d bytes", (int)sizeof(packet.bytes) - 2);
+		return;
+	}
+	_VISCA_init_packet(&packet);
+	for (i = 0; i < argc; i++) {
+		v = argv[i].a_type == A_FLOAT ? (long)argv[i].a_w.w_float
+			: strtol(atom_getsymbol(argv + i)->s_name, 0, 0);
+		if (v < 0 || v >= VISCA_TERMINATOR) {
+			pd_error(x, "[visca]: raw: bytes are 0-254");
+			return;
+		}
+		_VISCA_append_byte(&packet, (unsigned char)v);
+	}
+	visca_submit(x, "raw", VISCA_CMD_RAW, &packet);
 }
 /*-------------------------------------------*/
 
 
 /*-------------------------------------------*/
-// Enumerate Com Devices (uses libserialport)
+// Cue Banks
 /*-------------------------------------------*/
-static void visca_lstdevs() {
-    post("[visca]:  available serial ports:");
-    int i;
-    struct sp_port **ports;
-
-    enum sp_return error = sp_list_ports(&ports);
-    if (error == SP_OK) {
-      for (i = 0; ports[i]; i++) {
-        post("[visca]:  %d\t%s", i, sp_get_port_name(ports[i]));
-      }
-      sp_free_port_list(ports);
-    } else {
-      post("No serial devices detected");
-    }
-    post("");
+/* [cues file( compiles a text cue list into a bank of ready VISCA frames:
+ *
+ *   cue <name>
+ *   <camera> pantilt <pan> <tilt> [<pan speed> <tilt speed>]
+ *   <camera> zoom <value>
+ *   <camera> focus <value>
+ *   <camera> iris|shutter|gain <value>
+ *   <camera> ae auto|manual|shutter|iris|bright
+ *   <camera> raw <hex byte>...    (message body without header and terminator)
+ *
+ * Blank lines and lines starting with # are skipped. [go name( then costs
+ * no packet building: the I/O thread writes the cue's first wave in one
+ * go and reports [cue index failed latency_ms duration_ms( when every
+ * camera has answered.
+ */
+
+// one cue line as a message body; 0 and a reason when it makes no sense
+static const char *visca_cue_packet(VISCAPacket_t *packet, int argc, char **argv) {
+	const char *what = argv[0];
+	long v;
+	char *end;
+	int i;
+	_VISCA_init_packet(packet);
+	if (!strcmp(what, "raw")) {
+		for (i = 1; i < argc; i++) {
+			v = strtol(argv[i], &end, 16);
+			if (*end || v < 0 || v >= VISCA_TERMINATOR)
+				return "raw takes hex bytes";
+			if (packet->length >= VISCA_CUE_FRAME_BYTES - 1)
+				return "message too long";
+			_VISCA_append_byte(packet, (unsigned char)v);
+		}
+		return packet->length > 1 ? 0 : "raw needs a message";
+	}
+	if (argc < 2)
+		return "missing value";
+	_VISCA_append_byte(packet, VISCA_COMMAND);
+	if (!strcmp(what, "pantilt")) {
+		if (argc < 3)
+			return "pantilt needs pan and tilt";
+		_VISCA_append_byte(packet, VISCA_CATEGORY_PAN_TILTER);
+		_VISCA_append_byte(packet, VISCA_PT_ABSOLUTE_POSITION);
+		v = argc > 3 ? atoi(argv[3]) : VISCA_PAN_SPEED_MAX;
+		_VISCA_append_byte(packet, v < 1 ? 1 : v > VISCA_PAN_SPEED_MAX ? VISCA_PAN_SPEED_MAX : v);
+		v = argc > 4 ? atoi(argv[4]) : VISCA_TILT_SPEED_MAX;
+		_VISCA_append_byte(packet, v < 1 ? 1 : v > VISCA_TILT_SPEED_MAX ? VISCA_TILT_SPEED_MAX : v);
+		visca_append_nibbles(packet, atoi(argv[1]));
+		visca_append_nibbles(packet, atoi(argv[2]));
+		return 0;
+	}
+	_VISCA_append_byte(packet, VISCA_CATEGORY_CAMERA1);
+	if (!strcmp(what, "zoom") || !strcmp(what, "focus")) {
+		_VISCA_append_byte(packet, what[0] == 'z' ? VISCA_ZOOM_VALUE : VISCA_FOCUS_VALUE);
+		visca_append_nibbles(packet, atoi(argv[1]));
+	} else if (!strcmp(what, "iris") || !strcmp(what, "shutter") || !strcmp(what, "gain")) {
+		_VISCA_append_byte(packet, what[0] == 'i' ? VISCA_IRIS_VALUE
+			: what[0] == 's' ? VISCA_SHUTTER_VALUE : VISCA_GAIN_VALUE);
+		// 00 00 0p 0q
+		visca_append_nibbles(packet, atoi(argv[1]) & 0xFF);
+	} else if (!strcmp(what, "ae")) {
+		_VISCA_append_byte(packet, VISCA_AUTO_EXP);
+		if (!strcmp(argv[1], "auto")) _VISCA_append_byte(packet, VISCA_AUTO_EXP_FULL_AUTO);
+		else if (!strcmp(argv[1], "manual")) _VISCA_append_byte(packet, VISCA_AUTO_EXP_MANUAL);
+		else if (!strcmp(argv[1], "shutter")) _VISCA_append_byte(packet, VISCA_AUTO_EXP_SHUTTER_PRIORITY);
+		else if (!strcmp(argv[1], "iris")) _VISCA_append_byte(packet, VISCA_AUTO_EXP_IRIS_PRIORITY);
+		else if (!strcmp(argv[1], "bright")) _VISCA_append_byte(packet, VISCA_AUTO_EXP_BRIGHT);
+		else return "ae is auto, manual, shutter, iris or bright";
+	} else
+		return "unknown command";
+	return 0;
+}
+
+static void visca_bank_free(t_visca_bank *b) {
+	if (!b)
+		return;
+	freebytes(b->cues, b->ncues * sizeof(t_visca_cue));
+	freebytes(b->frames, b->nframes * sizeof(t_visca_frame));
+	freebytes(b->bytes, b->nbytes);
+	freebytes(b, sizeof(t_visca_bank));
+}
+
+// append a cue's frames, first wave first (one per camera per socket
+// round), the rest in list order
+static void visca_bank_add(t_visca_bank *b, t_symbol *name, int n,
+	const int *camera, const VISCAPacket_t *packets) {
+	t_visca_cue *cue;
+	t_visca_frame *f;
+	char placed[VISCA_CUE_FRAMES] = {0};
+	int round, cam, i, k, seen, start = b->nbytes;
+
+	b->cues = (t_visca_cue *)resizebytes(b->cues, b->ncues * sizeof(t_visca_cue),
+		(b->ncues + 1) * sizeof(t_visca_cue));
+	cue = &b->cues[b->ncues++];
+	cue->name = name;
+	cue->first = b->nframes;
+	cue->nframes = n;
+	cue->wave = 0;
+	b->frames = (t_visca_frame *)resizebytes(b->frames, b->nframes * sizeof(t_visca_frame),
+		(b->nframes + n) * sizeof(t_visca_frame));
+	b->bytes = (unsigned char *)resizebytes(b->bytes, b->nbytes,
+		b->nbytes + n * VISCA_CUE_FRAME_BYTES);
+	for (k = 0; k < n; k++) {
+		// the k-th frame to go out
+		i = -1;
+		for (round = 0; i < 0 && round < VISCA_SOCKETS; round++)
+			for (cam = 1; i < 0 && cam <= VISCA_MAX_CAMERAS; cam++) {
+				for (seen = 0, i = 0; i < n; i++)
+					if (camera[i] == cam && seen++ == round)
+						break;
+				if (i == n || placed[i])
+					i = -1;
+			}
+		if (i < 0)
+			for (i = 0; placed[i]; i++)
+				;
+		else
+			cue->wave++;
+		placed[i] = 1;
+		f = &b->frames[b->nframes++];
+		f->camera = camera[i];
+		f->offset = b->nbytes;
+		f->length = packets[i].length + 1;
+		b->bytes[b->nbytes] = 0x80 | camera[i];
+		memcpy(b->bytes + b->nbytes + 1, packets[i].bytes + 1, packets[i].length - 1);
+		b->bytes[b->nbytes + f->length - 1] = VISCA_TERMINATOR;
+		b->nbytes += f->length;
+		if (k + 1 == cue->wave)
+			cue->wave_bytes = b->nbytes - start;
+	}
+	cue->bytes = b->nbytes - start;
+	// unused room from the worst case estimate
+	b->bytes = (unsigned char *)resizebytes(b->bytes, start + n * VISCA_CUE_FRAME_BYTES, b->nbytes);
+}
+
+// compile a cue list; 0 after posting what is wrong with it
+static t_visca_bank *visca_bank_load(t_visca *x, const char *path) {
+	t_visca_bank *b;
+	VISCAPacket_t packets[VISCA_CUE_FRAMES];
+	int camera[VISCA_CUE_FRAMES];
+	t_symbol *name = 0;
+	char line[512], *argv[24];
+	const char *err = 0;
+	int argc, n = 0, lineno = 0;
+	FILE *fp;
+
+	if (!(fp = fopen(path, "r"))) {
+		pd_error(x, "[visca]: cues: can't open %s", path);
+		return 0;
+	}
+	b = (t_visca_bank *)getbytes(sizeof(t_visca_bank));
+	while (!err && fgets(line, sizeof(line), fp)) {
+		lineno++;
+		for (argc = 0, argv[0] = strtok(line, " \t\r\n"); argv[argc] && argc < 23;)
+			argv[++argc] = strtok(0, " \t\r\n");
+		if (!argc || argv[0][0] == '#')
+			continue;
+		if (!strcmp(argv[0], "cue")) {
+			if (name && n)
+				visca_bank_add(b, name, n, camera, packets);
+			name = argc > 1 ? gensym(argv[1]) : 0;
+			n = 0;
+			if (!name)
+				err = "cue needs a name";
+			continue;
+		}
+		if (!name)
+			err = "command before the first cue";
+		else if (n == VISCA_CUE_FRAMES)
+			err = "too many commands in one cue";
+		else if (argc < 2 || (camera[n] = atoi(argv[0])) < 1 || camera[n] > VISCA_MAX_CAMERAS)
+			err = "line must start with a camera address 1-7";
+		else if (!(err = visca_cue_packet(&packets[n], argc - 1, argv + 1)))
+			n++;
+	}
+	fclose(fp);
+	if (!err && name && n)
+		visca_bank_add(b, name, n, camera, packets);
+	if (err) {
+		pd_error(x, "[visca]: cues: %s line %d: %s", path, lineno, err);
+		visca_bank_free(b);
+		return 0;
+	}
+	return b;
+}
+
+// [cues file( loads a cue list, relative to the patch; a cue queued from
+// the old bank is dropped
+void visca_cues(t_visca *x, t_symbol *s) {
+	t_visca_bank *b, *old;
+	t_visca_queue *q;
+	char path[MAXPDSTRING];
+	int i, n;
+	if (s->s_name[0] == '/' || !x->canvas)
+		snprintf(path, sizeof(path), "%s", s->s_name);
+	else
+		snprintf(path, sizeof(path), "%s/%s", canvas_getdir(x->canvas)->s_name, s->s_name);
+	if (!(b = visca_bank_load(x, path)))
+		return;
+	old = x->bank;
+	if (x->conn) {
+		// the I/O thread only reads the bank while it holds client_lock
+		pthread_mutex_lock(&x->conn->client_lock);
+		pthread_mutex_lock(&x->conn->io_lock);
+		q = &x->conn->queues[VISCA_PRIO_MOTION];
+		for (i = n = q->head; i != q->tail; i = (i + 1) % VISCA_CMD_QUEUE) {
+			if (q->cmds[i].owner == x && q->cmds[i].kind == VISCA_CMD_CUE)
+				continue;
+			q->cmds[n] = q->cmds[i];
+			n = (n + 1) % VISCA_CMD_QUEUE;
+		}
+		q->tail = n;
+		for (i = n = 0; i < x->conn->ntimed; i++)
+			if (x->conn->timed[i].owner != x || x->conn->timed[i].kind != VISCA_CMD_CUE)
+				x->conn->timed[n++] = x->conn->timed[i];
+		x->conn->ntimed = n;
+		x->bank = b;
+		pthread_mutex_unlock(&x->conn->io_lock);
+		pthread_mutex_unlock(&x->conn->client_lock);
+	} else
+		x->bank = b;
+	visca_bank_free(old);
+	post("[visca]: %d cues, %d frames, %d bytes from %s", b->ncues, b->nframes, b->nbytes, path);
+}
+
+// [go name( fires a cue from the bank
+void visca_go(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_cmd cmd;
+	char name[MAXPDSTRING];
+	t_symbol *sym;
+	int i;
+	if (!x->conn) {
+		pd_error(x, "[visca]: go: open a serial port first");
+		return;
+	}
+	if (!argc || !x->bank) {
+		pd_error(x, "[visca]: go: load a cue list with [cues( and name a cue");
+		return;
+	}
+	atom_string(argv, name, sizeof(name));
+	sym = gensym(name);
+	for (i = 0; i < x->bank->ncues && x->bank->cues[i].name != sym; i++)
+		;
+	if (i == x->bank->ncues) {
+		pd_error(x, "[visca]: go: no cue %s", name);
+		return;
+	}
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.kind = VISCA_CMD_CUE;
+	cmd.prio = VISCA_PRIO_MOTION;
+	cmd.owner = x;
+	cmd.camera = x->address;
+	cmd.cue = i;
+	cmd.queued = visca_now_ms();
+	cmd.at = x->at;
+	if (!visca_io_submit(x->conn, &cmd))
+		pd_error(x, "[visca]: command queue full");
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Timed Commands
+/*-------------------------------------------*/
+/* [at ms sel args...( sends this object the message sel args..., and what
+ * that queues for the link is held by the I/O thread until ms after the
+ * current logical time. [at_clock sec ms sel args...( holds it until an
+ * absolute CLOCK_MONOTONIC time, which [clock( reports as [clock sec ms(.
+ * Logical time maps onto the monotonic clock through an offset that
+ * follows the earliest arrivals, so scheduler jitter in when the message
+ * comes in does not move the target. Each release reports [jitter ms(,
+ * how late the frame was written.
+ */
+
+// CLOCK_MONOTONIC ms of a logical time ms from now
+static double visca_at_logical(t_visca *x, double ms) {
+	double logical = clock_gettimesince(x->at_ref);
+	double offset = visca_now_ms() - logical;
+	// messages come in late but never early: a lower offset is the truth,
+	// a higher one is mostly delay (or slow drift)
+	if (x->at_offset == 0 || offset < x->at_offset)
+		x->at_offset = offset;
+	else
+		x->at_offset += (offset - x->at_offset) * VISCA_AT_SMOOTH;
+	return x->at_offset + logical + ms;
+}
+
+static void visca_at_send(t_visca *x, double at, int argc, t_atom *argv) {
+	if (argc < 1 || argv->a_type != A_SYMBOL) {
+		pd_error(x, "[visca]: at: missing message");
+		return;
+	}
+	if (x->at) {
+		pd_error(x, "[visca]: at: already timed");
+		return;
+	}
+	x->at = at;
+	pd_typedmess(&x->x_obj.ob_pd, argv->a_w.w_symbol, argc - 1, argv + 1);
+	x->at = 0;
+}
+
+void visca_at(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	if (argc < 1 || argv->a_type != A_FLOAT) {
+		pd_error(x, "[visca]: at: ms message...");
+		return;
+	}
+	visca_at_send(x, visca_at_logical(x, atom_getfloat(argv)), argc - 1, argv + 1);
+}
+
+void visca_at_clock(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	if (argc < 2 || argv[0].a_type != A_FLOAT || argv[1].a_type != A_FLOAT) {
+		pd_error(x, "[visca]: at_clock: sec ms message...");
+		return;
+	}
+	visca_at_send(x, atom_getfloat(argv) * 1000.0 + atom_getfloat(argv + 1), argc - 2, argv + 2);
+}
+
+// [clock( outputs CLOCK_MONOTONIC as [clock sec ms( (a float holds ms
+// since boot too coarsely)
+void visca_clock(t_visca *x) {
+	double now = visca_now_ms();
+	t_atom out[2];
+	SETFLOAT(&out[0], floor(now / 1000.0));
+	SETFLOAT(&out[1], now - floor(now / 1000.0) * 1000.0);
+	outlet_anything(x->data_out, gensym("clock"), 2, out);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Position Estimate Output
+/*-------------------------------------------*/
+// clock callback: output the predicted position, poll when it is due
+static void visca_estimate_tick(t_visca *x) {
+	t_visca_estimate *e;
+	float pos[VISCA_AXES];
+	t_atom out[VISCA_AXES];
+	double now = visca_now_ms();
+	int moving, known, i;
+	if (!x->conn || x->estimate_ms <= 0)
+		return;
+	e = &x->conn->estimates[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	visca_estimate_at(e, now, pos);
+	moving = e->vel[VISCA_AXIS_PAN] != 0 || e->vel[VISCA_AXIS_TILT] != 0
+		|| e->vel[VISCA_AXIS_ZOOM] != 0;
+	known = e->known == (1 << VISCA_AXES) - 1;
+	pthread_mutex_unlock(&x->conn->io_lock);
+	for (i = 0; i < VISCA_AXES; i++)
+		SETFLOAT(&out[i], pos[i]);
+	outlet_anything(x->data_out, gensym("estimate"), VISCA_AXES, out);
+	// poll at the set interval while moving, much slower while still
+	if (x->estimate_poll > 0 && now >= x->next_poll) {
+		visca_position(x);
+		visca_zoom_value(x);
+		x->next_poll = now + x->estimate_poll
+			* (moving || !known ? 1 : VISCA_ESTIMATE_IDLE_POLLS);
+	}
+	clock_delay(x->estimate_clock, x->estimate_ms);
+}
+
+// [estimate ms( output [estimate pan tilt zoom( every ms while open, 0 stops
+void visca_estimate(t_visca *x, t_floatarg f) {
+	x->estimate_ms = f > 0 ? f : 0;
+	x->next_poll = 0;
+	if (x->estimate_ms > 0)
+		visca_estimate_tick(x);
+	else
+		clock_unset(x->estimate_clock);
+}
+
+// [estimate_poll ms( real position inquiries while moving, 0 never
+void visca_estimate_poll(t_visca *x, t_floatarg f) {
+	x->estimate_poll = f > 0 ? f : 0;
+	x->next_poll = 0;
+}
+
+// [speed_table pan|tilt|zoom v1 v2 ...( units per second for each speed
+// index of this camera, starting at 1 (pan, tilt) or 0 (zoom)
+void visca_speed_table(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_estimate *e;
+	t_symbol *axis = atom_getsymbolarg(0, argc, argv);
+	float *table;
+	int first, last, i;
+	if (!x->conn) {
+		pd_error(x, "[visca]: speed_table: open a serial port first");
+		return;
+	}
+	e = &x->conn->estimates[x->address];
+	if (axis == gensym("pan")) {
+		table = e->pan_speeds; first = 1; last = VISCA_PAN_SPEED_MAX;
+	} else if (axis == gensym("tilt")) {
+		table = e->tilt_speeds; first = 1; last = VISCA_TILT_SPEED_MAX;
+	} else if (axis == gensym("zoom")) {
+		table = e->zoom_speeds; first = 0; last = VISCA_ZOOM_SPEED_MAX;
+	} else {
+		pd_error(x, "[visca]: speed_table: pan, tilt or zoom");
+		return;
+	}
+	pthread_mutex_lock(&x->conn->io_lock);
+	for (i = 1; i < argc && first + i - 1 <= last; i++)
+		table[first + i - 1] = atom_getfloatarg(i, argc, argv);
+	pthread_mutex_unlock(&x->conn->io_lock);
+}
+
+// [profile file( loads a speed profile written by visca_calibrate: lines
+// of model <vendor> <model>, units_per_degree pan|tilt <units>,
+// speed_table pan|tilt|zoom <values>, fov_table <degrees> (added by hand
+// from the camera's data sheet) and focus_curve <zoom focus ...> (as
+// [focus_curve( outputs it), relative to the patch
+void visca_profile(t_visca *x, t_symbol *s) {
+	t_visca_estimate e;
+	VISCACamera_t *cam;
+	char path[MAXPDSTRING], line[512], *argv[2 * VISCA_FOCUS_POINTS + 2];
+	float *table;
+	int argc, i, first, last, lineno = 0, bad = 0;
+	unsigned vendor, model;
+	FILE *fp;
+	if (!x->conn) {
+		pd_error(x, "[visca]: profile: open a serial port first");
+		return;
+	}
+	if (s->s_name[0] == '/' || !x->canvas)
+		snprintf(path, sizeof(path), "%s", s->s_name);
+	else
+		snprintf(path, sizeof(path), "%s/%s", canvas_getdir(x->canvas)->s_name, s->s_name);
+	if (!(fp = fopen(path, "r"))) {
+		pd_error(x, "[visca]: profile: can't open %s", path);
+		return;
+	}
+	cam = &x->conn->cameras[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	e = x->conn->estimates[x->address];
+	pthread_mutex_unlock(&x->conn->io_lock);
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		for (argc = 0, argv[0] = strtok(line, " \t\r\n"); argv[argc] && argc < 2 * VISCA_FOCUS_POINTS + 1;)
+			argv[++argc] = strtok(0, " \t\r\n");
+		if (!argc || argv[0][0] == '#')
+			continue;
+		if (!strcmp(argv[0], "model") && argc == 3) {
+			vendor = strtoul(argv[1], 0, 0);
+			model = strtoul(argv[2], 0, 0);
+			if (vendor != cam->vendor || model != cam->model)
+				post("[visca]: profile: %s was measured on model 0x%04x, camera %d is 0x%04x",
+					path, model, x->address, (unsigned)cam->model);
+		} else if (!strcmp(argv[0], "units_per_degree") && argc == 3
+			&& (!strcmp(argv[1], "pan") || !strcmp(argv[1], "tilt")) && atof(argv[2]) > 0) {
+			e.units_per_degree[!strcmp(argv[1], "pan") ? VISCA_AXIS_PAN : VISCA_AXIS_TILT] = atof(argv[2]);
+		} else if (!strcmp(argv[0], "focus_curve") && argc % 2 == 1) {
+			e.nfocus = 0;
+			for (i = 1; i + 1 < argc; i += 2)
+				visca_estimate_focus_point(&e, atof(argv[i]), atof(argv[i + 1]));
+		} else if (!strcmp(argv[0], "fov_table") && argc == VISCA_FOV_POINTS + 1) {
+			for (i = 0; i < VISCA_FOV_POINTS; i++)
+				e.fov[i] = atof(argv[i + 1]);
+		} else if (!strcmp(argv[0], "speed_table") && argc > 2) {
+			if (!strcmp(argv[1], "pan")) {
+				table = e.pan_speeds; first = 1; last = VISCA_PAN_SPEED_MAX;
+			} else if (!strcmp(argv[1], "tilt")) {
+				table = e.tilt_speeds; first = 1; last = VISCA_TILT_SPEED_MAX;
+			} else if (!strcmp(argv[1], "zoom")) {
+				table = e.zoom_speeds; first = 0; last = VISCA_ZOOM_SPEED_MAX;
+			} else {
+				bad = lineno;
+				break;
+			}
+			for (i = 2; i < argc && first + i - 2 <= last; i++)
+				table[first + i - 2] = atof(argv[i]);
+		} else {
+			bad = lineno;
+			break;
+		}
+	}
+	fclose(fp);
+	if (bad) {
+		pd_error(x, "[visca]: profile: %s line %d: not understood", path, bad);
+		return;
+	}
+	// the position may have moved on meanwhile: only the tables change
+	pthread_mutex_lock(&x->conn->io_lock);
+	memcpy(x->conn->estimates[x->address].pan_speeds, e.pan_speeds, sizeof(e.pan_speeds));
+	memcpy(x->conn->estimates[x->address].tilt_speeds, e.tilt_speeds, sizeof(e.tilt_speeds));
+	memcpy(x->conn->estimates[x->address].zoom_speeds, e.zoom_speeds, sizeof(e.zoom_speeds));
+	memcpy(x->conn->estimates[x->address].units_per_degree, e.units_per_degree,
+		sizeof(e.units_per_degree));
+	memcpy(x->conn->estimates[x->address].fov, e.fov, sizeof(e.fov));
+	memcpy(x->conn->estimates[x->address].focus_zoom, e.focus_zoom, sizeof(e.focus_zoom));
+	memcpy(x->conn->estimates[x->address].focus_value, e.focus_value, sizeof(e.focus_value));
+	x->conn->estimates[x->address].nfocus = e.nfocus;
+	pthread_mutex_unlock(&x->conn->io_lock);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Synchronized Moves
+/*-------------------------------------------*/
+/* An absolute pan/tilt move takes separate speed indices per axis, so a
+ * diagonal move at equal indices ends on one axis long before the other.
+ * [moveto( picks the pair from the camera's speed tables that makes both
+ * axes arrive together, as close to the wanted duration as the tables
+ * allow, and sends the move as one command.
+ */
+
+// [moveto pan tilt [ms [max]]( absolute move with both axes arriving
+// together after about ms (0 or none: as fast as speed index max allows);
+// answers [eta pan_speed tilt_speed ms( with the expected completion time
+void visca_moveto(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	VISCAPacket_t packet;
+	t_visca_estimate *e;
+	float pos[VISCA_AXES];
+	float pan = atom_getfloatarg(0, argc, argv);
+	float tilt = atom_getfloatarg(1, argc, argv);
+	float ms = atom_getfloatarg(2, argc, argv);
+	int max = argc > 3 ? (int)atom_getfloatarg(3, argc, argv) : VISCA_PAN_SPEED_MAX;
+	int known, max_pan, max_tilt, pan_speed, tilt_speed;
+	double travel;
+	t_atom out[3];
+	if (!x->conn) {
+		pd_error(x, "[visca]: moveto: open a serial port first");
+		return;
+	}
+	if (argc < 2) {
+		pd_error(x, "[visca]: moveto: pan tilt [ms [max speed]]");
+		return;
+	}
+	max_pan = max < 1 ? 1 : max > VISCA_PAN_SPEED_MAX ? VISCA_PAN_SPEED_MAX : max;
+	max_tilt = max_pan > VISCA_TILT_SPEED_MAX ? VISCA_TILT_SPEED_MAX : max_pan;
+	e = &x->conn->estimates[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	visca_estimate_at(e, visca_now_ms(), pos);
+	known = (e->known & (1 << VISCA_AXIS_PAN)) && (e->known & (1 << VISCA_AXIS_TILT));
+	travel = visca_plan_move(e, pan - pos[VISCA_AXIS_PAN], tilt - pos[VISCA_AXIS_TILT], ms,
+		max_pan, max_tilt, &pan_speed, &tilt_speed);
+	pthread_mutex_unlock(&x->conn->io_lock);
+	if (!known) {
+		pd_error(x, "[visca]: moveto: position unknown, ask [position( first");
+		return;
+	}
+	_VISCA_init_packet(&packet);
+	_VISCA_append_byte(&packet, VISCA_COMMAND);
+	_VISCA_append_byte(&packet, VISCA_CATEGORY_PAN_TILTER);
+	_VISCA_append_byte(&packet, VISCA_PT_ABSOLUTE_POSITION);
+	_VISCA_append_byte(&packet, pan_speed);
+	_VISCA_append_byte(&packet, tilt_speed);
+	visca_append_nibbles(&packet, (int)lrintf(pan));
+	visca_append_nibbles(&packet, (int)lrintf(tilt));
+	visca_submit(x, "moveto", VISCA_CMD_PANTILT_ABS, &packet);
+	// the command and its ACK on the wire come first
+	SETFLOAT(&out[0], pan_speed);
+	SETFLOAT(&out[1], tilt_speed);
+	SETFLOAT(&out[2], travel + (packet.length + 1 + VISCA_REPLY_BYTES / 2) * VISCA_BYTE_MS);
+	outlet_anything(x->data_out, gensym("eta"), 3, out);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Signal Control [visca~]
+/*-------------------------------------------*/
+/* [visca~] is [visca] with pan, tilt, zoom and focus signal inlets. Each
+ * DSP block is reduced to its last sample; a clock outside the DSP tick
+ * compares it with what was last sent and queues a drive (speed mode,
+ * inlets in -1..1) or a position target (absolute mode, VISCA units)
+ * when it changed by more than the deadband and the command's interval
+ * has passed. Queued drives and targets coalesce per camera, so the I/O
+ * thread only ever sends the newest one.
+ */
+
+// signed speed index for a -1..1 control value
+static int visca_sig_speed(float v, float deadband, int max) {
+	int speed;
+	if (fabsf(v) <= deadband)
+		return 0;
+	speed = (int)lrintf(fabsf(v) * max);
+	if (speed < 1) speed = 1;
+	if (speed > max) speed = max;
+	return v < 0 ? -speed : speed;
+}
+
+// zoom or focus: variable speed drive, or direct position
+static void visca_sig_lens_packet(VISCAPacket_t *packet, int item, int absolute, float v) {
+	_VISCA_init_packet(packet);
+	_VISCA_append_byte(packet, VISCA_COMMAND);
+	_VISCA_append_byte(packet, VISCA_CATEGORY_CAMERA1);
+	if (absolute) {
+		_VISCA_append_byte(packet, item == VISCA_ZOOM ? VISCA_ZOOM_VALUE : VISCA_FOCUS_VALUE);
+		visca_append_nibbles(packet, (int)v);
+	} else {
+		_VISCA_append_byte(packet, item);
+		// tele and far share the 0x2p code, wide and near 0x3p
+		_VISCA_append_byte(packet, v > 0 ? VISCA_ZOOM_TELE_SPEED | (int)v
+			: v < 0 ? VISCA_ZOOM_WIDE_SPEED | (int)-v : VISCA_ZOOM_STOP);
+	}
+}
+
+// has a channel moved far enough to be worth link time?
+static int visca_sig_changed(t_visca *x, int ch, float *value) {
+	float v = x->sig_in[ch];
+	int max = ch == 0 ? VISCA_PAN_SPEED_MAX : ch == 1 ? VISCA_TILT_SPEED_MAX
+		: ch == 2 ? VISCA_ZOOM_SPEED_MAX : VISCA_FOCUS_SPEED_MAX;
+	if (!(x->sig_channels & (1 << ch))) {
+		*value = x->sig_sent[ch];
+		return 0;
+	}
+	if (x->sig_absolute) {
+		*value = v;
+		return fabsf(v - x->sig_sent[ch]) > x->sig_deadband;
+	}
+	*value = visca_sig_speed(v, x->sig_deadband, max);
+	return *value != x->sig_sent[ch];
+}
+
+// clock callback after a DSP block: queue whatever changed and is due
+static void visca_tilde_tick(t_visca *x) {
+	VISCAPacket_t packet;
+	float v[VISCA_SIG_CHANNELS];
+	int changed[VISCA_SIG_CHANNELS];
+	int ch, g, kind, p, t;
+	double interval;
+	x->sig_pending = 0;
+	if (!x->conn)
+		return;
+	for (ch = 0; ch < VISCA_SIG_CHANNELS; ch++)
+		changed[ch] = visca_sig_changed(x, ch, &v[ch]);
+	for (g = 0; g < VISCA_SIG_GROUPS; g++) {
+		if (g == VISCA_SIG_PANTILT ? !(changed[0] || changed[1]) : !changed[g + 1])
+			continue;
+		if (g == VISCA_SIG_PANTILT && x->sig_absolute) {
+			_VISCA_init_packet(&packet);
+			_VISCA_append_byte(&packet, VISCA_COMMAND);
+			_VISCA_append_byte(&packet, VISCA_CATEGORY_PAN_TILTER);
+			_VISCA_append_byte(&packet, VISCA_PT_ABSOLUTE_POSITION);
+			_VISCA_append_byte(&packet, VISCA_PAN_SPEED_MAX);
+			_VISCA_append_byte(&packet, VISCA_TILT_SPEED_MAX);
+			visca_append_nibbles(&packet, (int)v[0]);
+			visca_append_nibbles(&packet, (int)v[1]);
+			kind = VISCA_CMD_PANTILT_ABS;
+		} else if (g == VISCA_SIG_PANTILT) {
+			p = (int)v[0];
+			t = (int)v[1];
+			visca_drive_packet(&packet, p < 0 ? -1 : p > 0, t > 0 ? -1 : t < 0,
+				p < 0 ? -p : p, t < 0 ? -t : t);
+			kind = VISCA_CMD_DRIVE;
+		} else {
+			visca_sig_lens_packet(&packet, g == VISCA_SIG_ZOOM ? VISCA_ZOOM : VISCA_FOCUS,
+				x->sig_absolute, v[g + 1]);
+			kind = g == VISCA_SIG_ZOOM ? VISCA_CMD_ZOOM : VISCA_CMD_FOCUS;
+		}
+		// never faster than the link can carry the command and its replies
+		interval = (packet.length + 1 + VISCA_REPLY_BYTES) * VISCA_BYTE_MS;
+		if (interval < x->sig_interval)
+			interval = x->sig_interval;
+		if (clock_gettimesince(x->sig_stamp[g]) < interval)
+			continue;
+		visca_submit(x, "visca~", kind, &packet);
+		x->sig_stamp[g] = clock_getlogicaltime();
+		if (g == VISCA_SIG_PANTILT) {
+			x->sig_sent[0] = v[0];
+			x->sig_sent[1] = v[1];
+		} else
+			x->sig_sent[g + 1] = v[g + 1];
+	}
+}
+
+static t_int *visca_tilde_perform(t_int *w) {
+	t_visca *x = (t_visca *)(w[1]);
+	int n = (int)(w[2 + VISCA_SIG_CHANNELS]), ch;
+	for (ch = 0; ch < VISCA_SIG_CHANNELS; ch++)
+		x->sig_in[ch] = ((t_sample *)(w[2 + ch]))[n - 1];
+	// serial work happens after the tick, never inside it
+	if (x->conn && !x->sig_pending) {
+		x->sig_pending = 1;
+		clock_delay(x->sig_clock, 0);
+	}
+	return (w + 3 + VISCA_SIG_CHANNELS);
+}
+
+static void visca_tilde_dsp(t_visca *x, t_signal **sp) {
+	dsp_add(visca_tilde_perform, 2 + VISCA_SIG_CHANNELS, x,
+		sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, (t_int)sp[0]->s_n);
+}
+
+// [mode speed( inlets are -1..1 speeds, [mode absolute( VISCA positions
+void visca_tilde_mode(t_visca *x, t_symbol *s) {
+	x->sig_absolute = s == gensym("absolute");
+	if (!x->sig_absolute && s != gensym("speed"))
+		pd_error(x, "[visca~]: mode: speed or absolute");
+	// the last sent values mean something else now: resend everything
+	memset(x->sig_sent, 0, sizeof(x->sig_sent));
+	memset(x->sig_stamp, 0, sizeof(x->sig_stamp));
+	if (x->sig_absolute)
+		x->sig_deadband = 1;
+	else
+		x->sig_deadband = 0.02;
+}
+
+// [channels pan tilt zoom focus( 1 to follow an inlet, 0 to ignore it
+void visca_tilde_channels(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	int ch;
+	x->sig_channels = 0;
+	for (ch = 0; ch < VISCA_SIG_CHANNELS; ch++)
+		if (atom_getfloatarg(ch, argc, argv) != 0)
+			x->sig_channels |= 1 << ch;
+}
+
+// [interval ms( shortest time between two commands of one kind
+void visca_tilde_interval(t_visca *x, t_floatarg f) {
+	x->sig_interval = f > 0 ? f : 0;
+}
+
+// [deadband d( change (speed fraction or position units) that is ignored
+void visca_tilde_deadband(t_visca *x, t_floatarg f) {
+	x->sig_deadband = f > 0 ? f : 0;
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Low Latency Mode
+/*-------------------------------------------*/
+// [low_latency 1( asks the driver and FTDI adapters to pass received bytes
+// on at once instead of batching them (up to 16 ms per reply). Applied by
+// the I/O thread while the link is up; reports [latency 1/0( on outlet 2.
+// The setting belongs to the port, so the last object to ask wins.
+void visca_low_latency(t_visca *x, t_floatarg f) {
+	x->low_latency = (f != 0);
+	if (!x->conn)
+		return;
+	pthread_mutex_lock(&x->conn->io_lock);
+	x->conn->low_latency = x->low_latency;
+	pthread_mutex_unlock(&x->conn->io_lock);
+	visca_io_kick(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// ACK-Return Mode
+/*-------------------------------------------*/
+// Motion commands always return at the camera's ACK instead of holding the
+// link until the move is done, so stops, inquiries and other cameras'
+// commands go out meanwhile. [ack_return 1( reports their completions as
+// [completed camera error ms( (error 0 when it went fine, ms since the ACK).
+// A camera runs two commands at once; a third waits in the queue until one
+// of them completes.
+void visca_ack_return(t_visca *x, t_floatarg f) {
+	x->ack_return = (f != 0);
+	if (!x->conn)
+		return;
+	pthread_mutex_lock(&x->conn->io_lock);
+	x->conn->ack_return = x->ack_return;
+	pthread_mutex_unlock(&x->conn->io_lock);
+	visca_io_kick(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Session Cache
+/*-------------------------------------------*/
+// [session_file path( keeps the session cache in a file across Pd runs:
+// what the file holds is merged in now and it is rewritten after every
+// full handshake; [session_file( without a path stops using it
+void visca_session_file(t_visca *x, t_symbol *s) {
+	const char *home = getenv("HOME");
+	pthread_mutex_lock(&visca_session_lock);
+	if (!strncmp(s->s_name, "~/", 2) && home)
+		snprintf(visca_session_path, sizeof(visca_session_path), "%s%s", home, s->s_name + 1);
+	else
+		snprintf(visca_session_path, sizeof(visca_session_path), "%s", s->s_name);
+	visca_session_load();
+	pthread_mutex_unlock(&visca_session_lock);
+}
+
+// [session_forget( drops every cached session: the next open or reconnect
+// does the full handshake
+void visca_session_forget(t_visca *x) {
+	pthread_mutex_lock(&visca_session_lock);
+	visca_nsessions = 0;
+	visca_session_save();
+	pthread_mutex_unlock(&visca_session_lock);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Host Side Auto-Tracking
+/*-------------------------------------------*/
+// [track 1( starts the loop, [track 0( stops it and the head
+void visca_track(t_visca *x, t_floatarg f) {
+	if (f != 0 && !x->conn) {
+		pd_error(x, "[visca]: track: open a serial port first");
+		return;
+	}
+	visca_params_lock(x);
+	x->track.on = (f != 0);
+	visca_params_unlock(x);
+	visca_io_kick(x);
+}
+
+// [track_gains kp ki kd(
+void visca_track_gains(t_visca *x, t_floatarg kp, t_floatarg ki, t_floatarg kd) {
+	visca_params_lock(x);
+	x->track.kp = kp;
+	x->track.ki = ki;
+	x->track.kd = kd;
+	visca_params_unlock(x);
+}
+
+// [track_rate hz( requested loop rate, capped by the link budget
+void visca_track_rate(t_visca *x, t_floatarg hz) {
+	visca_params_lock(x);
+	x->track.rate = hz > 0 ? hz : 1;
+	visca_params_unlock(x);
+	post("[visca]: tracking period %.1f ms", visca_track_period(&x->track));
+	visca_io_kick(x);
+}
+
+// [track_budget fraction( share of the link the tracking loop may use
+void visca_track_budget(t_visca *x, t_floatarg f) {
+	visca_params_lock(x);
+	x->track.budget = (f > 0 && f <= 1) ? f : 1;
+	visca_params_unlock(x);
+	post("[visca]: tracking period %.1f ms", visca_track_period(&x->track));
+}
+
+// [track_frame cx cy rx ry( frame centre and half extent in AT position units
+void visca_track_frame(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	visca_params_lock(x);
+	x->track.center_x = atom_getfloatarg(0, argc, argv);
+	x->track.center_y = atom_getfloatarg(1, argc, argv);
+	if (argc > 2 && atom_getfloatarg(2, argc, argv) > 0)
+		x->track.range_x = atom_getfloatarg(2, argc, argv);
+	if (argc > 3 && atom_getfloatarg(3, argc, argv) > 0)
+		x->track.range_y = atom_getfloatarg(3, argc, argv);
+	visca_params_unlock(x);
+}
+
+// [track_deadband d( normalised error below which an axis is held still
+void visca_track_deadband(t_visca *x, t_floatarg f) {
+	visca_params_lock(x);
+	x->track.deadband = f >= 0 ? f : 0;
+	visca_params_unlock(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Follow Mode
+/*-------------------------------------------*/
+// [follow camera [pan tilt [zoom]]( copy the pose of another camera on the
+// chain, offset by pan, tilt and zoom units; [follow 0( stops following
+void visca_follow(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	int master = (int)atom_getfloatarg(0, argc, argv);
+	int i;
+	if (master != 0 && !x->conn) {
+		pd_error(x, "[visca]: follow: open a serial port first");
+		return;
+	}
+	if (master < 0 || master > VISCA_MAX_CAMERAS || (master && master == x->address)) {
+		pd_error(x, "[visca]: follow: camera 1-%d other than this object's, 0 stops",
+			VISCA_MAX_CAMERAS);
+		return;
+	}
+	visca_params_lock(x);
+	x->follow.master = master;
+	for (i = 0; i < VISCA_AXES; i++)
+		x->follow.offset[i] = atom_getfloatarg(i + 1, argc, argv);
+	x->follow.settled = 0;
+	x->follow.next_poll = 0;
+	visca_params_unlock(x);
+	visca_io_kick(x);
+}
+
+// [follow_mirror 1( pan turns the other way round from the master's
+void visca_follow_mirror(t_visca *x, t_floatarg f) {
+	visca_params_lock(x);
+	x->follow.mirror = (f != 0);
+	x->follow.settled = 0;
+	visca_params_unlock(x);
+	visca_io_kick(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// World-Space Look-At
+/*-------------------------------------------*/
+/* World coordinates are right-handed with z up, in whatever unit the
+ * tracker uses. A mount's yaw turns the camera's pan zero counterclockwise
+ * from the x axis seen from above, pitch tips it up and roll lifts its left
+ * side, all in degrees.
+ */
+
+// [mount x y z yaw pitch [roll]( where this object's camera sits in the
+// world; [mount( takes it out of look-at
+void visca_mount(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_aim *a;
+	float yaw, pitch, roll, cy, sy, cp, sp, cr, sr;
+	int i;
+	if (!x->conn) {
+		pd_error(x, "[visca]: mount: open a serial port first");
+		return;
+	}
+	if (argc != 0 && argc < 5) {
+		pd_error(x, "[visca]: mount: x y z yaw pitch [roll]");
+		return;
+	}
+	yaw = atom_getfloatarg(3, argc, argv) * M_PI / 180;
+	pitch = atom_getfloatarg(4, argc, argv) * M_PI / 180;
+	roll = atom_getfloatarg(5, argc, argv) * M_PI / 180;
+	cy = cosf(yaw);
+	sy = sinf(yaw);
+	cp = cosf(pitch);
+	sp = sinf(pitch);
+	cr = cosf(roll);
+	sr = sinf(roll);
+	a = &x->conn->aims[x->address];
+	pthread_mutex_lock(&x->conn->io_lock);
+	a->mounted = argc > 0;
+	for (i = 0; i < 3; i++)
+		a->origin[i] = atom_getfloatarg(i, argc, argv);
+	// columns of Rz(yaw) Ry(-pitch) Rx(roll)
+	a->axes[0][0] = cy * cp;
+	a->axes[0][1] = sy * cp;
+	a->axes[0][2] = sp;
+	a->axes[1][0] = -cy * sp * sr - sy * cr;
+	a->axes[1][1] = -sy * sp * sr + cy * cr;
+	a->axes[1][2] = cp * sr;
+	a->axes[2][0] = -cy * sp * cr + sy * sr;
+	a->axes[2][1] = -sy * sp * cr - cy * sr;
+	a->axes[2][2] = cp * cr;
+	a->stamp = 0;
+	a->settled = 0;
+	pthread_mutex_unlock(&x->conn->io_lock);
+}
+
+// [look_at x y z [width]( aim every mounted camera on the chain at a world
+// point, zooming so width world units fill the frame; [look_at( stops.
+// Replies (done events of the parking moves) come to this object.
+void visca_look_at(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
+	t_visca_conn *c = x->conn;
+	int i;
+	if (!c) {
+		pd_error(x, "[visca]: look_at: open a serial port first");
+		return;
+	}
+	if (argc != 0 && argc < 3) {
+		pd_error(x, "[visca]: look_at: x y z [width]");
+		return;
+	}
+	pthread_mutex_lock(&c->io_lock);
+	if (argc) {
+		c->look.owner = x;
+		for (i = 0; i < 3; i++)
+			c->look.point[i] = atom_getfloatarg(i, argc, argv);
+		c->look.width = argc > 3 && atom_getfloatarg(3, argc, argv) > 0
+			? atom_getfloatarg(3, argc, argv) : 0;
+		c->look.fresh = 1;
+		c->look.stamp = visca_now_ms();
+	} else {
+		c->look.owner = 0;
+		for (i = 1; i <= VISCA_MAX_CAMERAS; i++)
+			c->aims[i].stamp = 0;
+	}
+	pthread_mutex_unlock(&c->io_lock);
+	visca_io_kick(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Camera Address
+/*-------------------------------------------*/
+// [camera n( picks the camera on the daisy chain (1-7) this object talks to
+void visca_camera(t_visca *x, t_floatarg f) {
+	int address = (int)f;
+	if (address < 1 || address > VISCA_MAX_CAMERAS) {
+		pd_error(x, "[visca]: camera: address must be 1-%d", VISCA_MAX_CAMERAS);
+		return;
+	}
+	if (x->conn && address > x->conn->ncameras)
+		post("[visca]: camera %d not found on %s", address, x->conn->port->s_name);
+	visca_params_lock(x);
+	x->address = address;
+	visca_params_unlock(x);
+}
+/*-------------------------------------------*/
+
+
+/*-------------------------------------------*/
+// Shared Connections
+/*-------------------------------------------*/
+/* Objects opened on the same port, or on a name given to an earlier [open(,
+ * share one connection: one serial handle, one handshake, one I/O thread.
+ * The last object to close it closes the port.
+ */
+static t_visca_conn *visca_conn_find(t_symbol *name) {
+	t_visca_conn *c;
+	for (c = visca_conns; c; c = c->next)
+		if (c->port == name || c->alias == name)
+			return c;
+	return 0;
+}
+
+// open, handshake and start the I/O thread; posts what went wrong on failure
+static t_visca_conn *visca_conn_new(t_symbol *port, t_symbol *alias) {
+	t_visca_conn *c = (t_visca_conn *)getbytes(sizeof(t_visca_conn));
+	const char *err;
+	int i;
+	c->port = port;
+	c->alias = alias;
+	c->iface.port_fd = -1;
+	for (i = 0; i <= VISCA_MAX_CAMERAS; i++) {
+		c->shares[i].weight = 1;
+		visca_estimate_init(&c->estimates[i]);
+	}
+	if (VISCA_open_serial(&c->iface, port->s_name)==VISCA_SUCCESS) {
+		post(port->s_name);
+		post("Serial Connection Established");
+	}
+	else{
+		post("Serial Connection Unsuccessful");
+		freebytes(c, sizeof(t_visca_conn));
+		return 0;
+	}
+	visca_link_identify(c, port->s_name);
+	if ((err = visca_handshake(c))) {
+		post("visca-cli: %s\n", err);
+		VISCA_close_serial(&c->iface);
+		freebytes(c, sizeof(t_visca_conn));
+		return 0;
+	}
+	post(c->resumed ? "Camera initialisation successful (cached session).\n"
+		: "Camera initialisation successful.\n");
+	pthread_mutex_init(&c->iface_lock, 0);
+	pthread_mutex_init(&c->client_lock, 0);
+	pthread_mutex_init(&c->io_lock, 0);
+	if (!visca_io_start(c)) {
+		post("[visca]: unable to start the I/O thread");
+		VISCA_close_serial(&c->iface);
+		pthread_mutex_destroy(&c->io_lock);
+		pthread_mutex_destroy(&c->client_lock);
+		pthread_mutex_destroy(&c->iface_lock);
+		freebytes(c, sizeof(t_visca_conn));
+		return 0;
+	}
+	c->next = visca_conns;
+	visca_conns = c;
+	return c;
+}
+
+static void visca_conn_free(t_visca_conn *c) {
+	// read the rest of the data: (should be empty)
+	unsigned char packet[3000];
+	uint32_t buffer_size = 3000;
+	t_visca_conn **p;
+
+	for (p = &visca_conns; *p; p = &(*p)->next)
+		if (*p == c) {
+			*p = c->next;
+			break;
+		}
+	visca_io_stop(c);
+	visca_latency_release(c);
+	VISCA_usleep(2000);
+
+	if (c->iface.port_fd != -1) {
+		if (VISCA_unread_bytes(&c->iface, packet, &buffer_size)!=VISCA_SUCCESS){
+			uint32_t i;
+			post("ERROR: %u bytes not processed", buffer_size);
+			for (i=0;i<buffer_size;i++)
+				post("%2x ",packet[i]);
+			post("\n");
+		}
+		if(VISCA_close_serial(&c->iface)==VISCA_SUCCESS){
+			post("Connection Closed");
+		}
+	}
+	pthread_mutex_destroy(&c->io_lock);
+	pthread_mutex_destroy(&c->client_lock);
+	pthread_mutex_destroy(&c->iface_lock);
+	freebytes(c, sizeof(t_visca_conn));
+}
+
+// register the object as a client of the connection
+static int visca_conn_attach(t_visca_conn *c, t_visca *x) {
+	pthread_mutex_lock(&c->io_lock);
+	if (c->nclients == VISCA_CONN_CLIENTS) {
+		pthread_mutex_unlock(&c->io_lock);
+		return 0;
+	}
+	x->track.next = visca_now_ms();
+	x->track.pan_dir = x->track.tilt_dir = 0;
+	c->clients[c->nclients++] = x;
+	if (x->low_latency)
+		c->low_latency = 1;
+	if (x->ack_return)
+		c->ack_return = 1;
+	c->refcount++;
+	x->conn = c;
+	pthread_mutex_unlock(&c->io_lock);
+	sp_event_set_wakeup(c->io_events);
+	clock_delay(x->poll_clock, VISCA_POLL_MS);
+	if (x->estimate_ms > 0)
+		clock_delay(x->estimate_clock, 0);
+	return 1;
+}
+
+// the thread is idle or waiting on the wire while client_lock is ours, and
+// looks objects up again after a wait: nothing refers to x afterwards
+static void visca_conn_detach(t_visca *x) {
+	t_visca_conn *c = x->conn;
+	int i, pantilt, zoom, orphaned = 0;
+	if (!c)
+		return;
+	pthread_mutex_lock(&c->client_lock);
+	pthread_mutex_lock(&c->io_lock);
+	for (i = 0; i < c->nclients; i++)
+		if (c->clients[i] == x) {
+			c->clients[i] = c->clients[--c->nclients];
+			break;
+		}
+	visca_io_purge(c, x);
+	x->track.on = 0;
+	x->follow.master = 0;
+	// the thread only stops heads for attached objects
+	pantilt = x->track.pan_dir || x->track.tilt_dir || x->follow.pan_dir || x->follow.tilt_dir;
+	zoom = x->follow.zoom_dir != 0;
+	x->track.pan_dir = x->track.tilt_dir = 0;
+	x->follow.pan_dir = x->follow.tilt_dir = x->follow.zoom_dir = 0;
+	// a camera left without an object is followed no more: the thread
+	// halts its followers as it does after [follow 0(
+	for (i = 0; i < c->nclients && c->clients[i]->address != x->address; i++)
+		;
+	if (i == c->nclients)
+		for (i = 0; i < c->nclients; i++)
+			if (c->clients[i]->follow.master == x->address) {
+				c->clients[i]->follow.master = 0;
+				orphaned = 1;
+			}
+	if (c->look.owner == x)
+		c->look.owner = 0;
+	pthread_mutex_unlock(&c->io_lock);
+	if (pantilt || zoom)
+		visca_io_halt(c, x->address, pantilt, zoom);
+	else if (orphaned)
+		sp_event_set_wakeup(c->io_events);
+	pthread_mutex_unlock(&c->client_lock);
+	x->conn = 0;
+	clock_unset(x->poll_clock);
+	clock_unset(x->estimate_clock);
+	if (--c->refcount == 0)
+		visca_conn_free(c);
 }
 /*-------------------------------------------*/
 
@@ -68,52 +4535,43 @@ static void visca_lstdevs() {
 /*-------------------------------------------*/
 // Open Visca Interface
 /*-------------------------------------------*/
+// [open port( or [open port name( opens the port and optionally names the
+// connection; [open name( or [open port( on an open port shares it
 void visca_opencom(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
-  	char comstr[1000];
-  	int camera_num;
-  	atom_string(argv, comstr, 1000);
-	
+  	t_visca_conn *c;
+  	t_symbol *port, *alias = 0;
+
   	if (argc<1){
 		post("Please provide a serial port device. Ex. /dev/cu.usbserial-FTGBV1NE\n");
+		return;
     	}
-	if (argc>=1){
-		//atom_string(argv, comstr, 1000);	
-  		if (VISCA_open_serial(&x->iface, comstr)==VISCA_SUCCESS) {
-	  	  	post(comstr);
-	  		post("Serial Connection Established");
-  		}
-		else{
-			post("Serial Connection Unsuccessful");
-		}
-	}
-
-  	x->iface.broadcast=0;
-  	VISCA_set_address(&x->iface, &camera_num);
-  	if(VISCA_set_address(&x->iface, &camera_num)!=VISCA_SUCCESS) {
-		#ifdef WIN
-    	_RPTF0(_CRT_WARN,"unable to set address\n");
-		#endif
-    	post("visca-cli: unable to set address\n");
-    	VISCA_close_serial(&x->iface);
+  	if (x->conn){
+		post("Close the current connection first");
+		return;
   	}
-
-  	x->camera.address=1;
-
-  	if(VISCA_clear(&x->iface, &x->camera)!=VISCA_SUCCESS) {
-		#ifdef WIN
-    	_RPTF0(_CRT_WARN,"unable to clear interface\n");
-		#endif
-    	post("visca-cli: unable to clear interface\n");
-    	VISCA_close_serial(&x->iface);
+  	port = atom_getsymbolarg(0, argc, argv);
+  	if (argc > 1)
+  		alias = atom_getsymbolarg(1, argc, argv);
+  	if ((c = visca_conn_find(port))) {
+  		if (alias && c->alias && c->alias != alias)
+  			post("[visca]: %s is already open as %s", port->s_name, c->alias->s_name);
+  		else if (alias && !c->alias && !visca_conn_find(alias))
+  			c->alias = alias;
+  	}
+  	else if (alias && visca_conn_find(alias)) {
+  		pd_error(x, "[visca]: the name %s is in use by another port", alias->s_name);
+  		return;
   	}
-  	if(VISCA_get_camera_info(&x->iface, &x->camera)!=VISCA_SUCCESS) {
-		#ifdef WIN
-    	_RPTF0(_CRT_WARN,"unable to oget camera infos\n");
-		#endif
-    	post("visca-cli: unable to oget camera infos\n");
-    	VISCA_close_serial(&x->iface);
+  	else if (!(c = visca_conn_new(port, alias)))
+  		return;
+  	if (!visca_conn_attach(c, x)) {
+  		pd_error(x, "[visca]: too many objects on %s", c->port->s_name);
+  		if (c->refcount == 0)
+  			visca_conn_free(c);
+  		return;
   	}
-  	post("Camera initialisation successful.\n");
+  	if (x->address > c->ncameras)
+  		post("[visca]: camera %d not found on %s", x->address, c->port->s_name);
 }
 /*------------------------------------------------------*/
 
@@ -122,22 +4580,7 @@ void visca_opencom(t_visca *x, t_symbol *s, int argc, t_atom *argv) {
 // Close Visca Interface
 /*-------------------------------------------*/
 void visca_closecom(t_visca *x){
-  	// read the rest of the data: (should be empty)
-  	unsigned char packet[3000];
-  	uint32_t buffer_size = 3000;
-
-  	VISCA_usleep(2000);
-
-  	if (VISCA_unread_bytes(&x->iface, packet, &buffer_size)!=VISCA_SUCCESS){
-    	uint32_t i;
-    	post("ERROR: %u bytes not processed", buffer_size);
-    	for (i=0;i<buffer_size;i++)
-      	  	post("%2x ",packet[i]);
-    		post("\n");
-  	}
-  	if(VISCA_close_serial(&x->iface)==VISCA_SUCCESS){
-	post("Connection Closed");
-	}
+  	visca_conn_detach(x);
 }
 /*-------------------------------------------*/
 
@@ -249,7 +4692,7 @@ int doCommand(t_visca *x, char *commandline, int *ret1, int *ret2, int *ret3) {
 
 // TEST COMMANDS
   if (strcmp(command, "set_zoom_tele") == 0) {
-    if (VISCA_set_zoom_tele(&x->iface, &x->camera)!=VISCA_SUCCESS) {
+    if (VISCA_set_zoom_tele(&x->conn->iface, &x->conn->cameras[x->address])!=VISCA_SUCCESS) {
       return 46;
     }
     return 10;
@@ -261,7 +4704,7 @@ int doCommand(t_visca *x, char *commandline, int *ret1, int *ret2, int *ret3) {
     if ((arg2 == NULL) || (intarg2 < 1) || (intarg2 > 20)) {
       return 42;
     }
-    if (VISCA_set_pantilt_left(&x->iface, &x->camera, intarg1, intarg2)
+    if (VISCA_set_pantilt_left(&x->conn->iface, &x->conn->cameras[x->address], intarg1, intarg2)
         != VISCA_SUCCESS) {
       return 46;
     }
@@ -275,7 +4718,7 @@ int doCommand(t_visca *x, char *commandline, int *ret1, int *ret2, int *ret3) {
     if ((arg2 == NULL) || (intarg2 < 1) || (intarg2 > 20)) {
       return 42;
     }
-    if (VISCA_set_pantilt_right(&x->iface, &x->camera, intarg1, intarg2)
+    if (VISCA_set_pantilt_right(&x->conn->iface, &x->conn->cameras[x->address], intarg1, intarg2)
         != VISCA_SUCCESS) {
       return 46;
     }
@@ -374,39 +4817,97 @@ void visca_testsym(t_visca *x, t_symbol *s, t_int argc, t_atom *argv){
 void visca_pantest(t_visca *x){
 	int pan_pos, tilt_pos;
 	
-  	if (VISCA_set_pantilt_absolute_position(&x->iface, &x->camera,5,5,-500,-200)!=VISCA_SUCCESS)
+	if (!x->conn) {
+		pd_error(x, "[visca]: pan: open a serial port first");
+		return;
+	}
+	pthread_mutex_lock(&x->conn->iface_lock);
+  	if (VISCA_set_pantilt_absolute_position(&x->conn->iface, &x->conn->cameras[x->address],5,5,-500,-200)!=VISCA_SUCCESS)
     	post("error setting pan tilt absolute position with negative position\n");
   	else
     	post("Setting pan tilt absolute position");
-  	if (VISCA_get_pantilt_position(&x->iface, &x->camera, &pan_pos, &tilt_pos)!=VISCA_SUCCESS)
+  	if (VISCA_get_pantilt_position(&x->conn->iface, &x->conn->cameras[x->address], &pan_pos, &tilt_pos)!=VISCA_SUCCESS)
     	post("error getting pan tilt absolute position\n");
   	else
     	post("Absolute position, Pan value: %d, Tilt value: %d",pan_pos,tilt_pos);
-  	if (VISCA_set_pantilt_absolute_position(&x->iface, &x->camera,18,14,500,200)!=VISCA_SUCCESS)
+  	if (VISCA_set_pantilt_absolute_position(&x->conn->iface, &x->conn->cameras[x->address],18,14,500,200)!=VISCA_SUCCESS)
     	post("error setting pan tilt absolute position with positive position\n");
   	else
     	post("Setting pan tilt absolute position");
-  	if (VISCA_get_pantilt_position(&x->iface, &x->camera, &pan_pos, &tilt_pos)!=VISCA_SUCCESS)
+  	if (VISCA_get_pantilt_position(&x->conn->iface, &x->conn->cameras[x->address], &pan_pos, &tilt_pos)!=VISCA_SUCCESS)
     	post("error getting pan tilt absolute position\n");
   	else
     	post("Absolute position, Pan value: %d, Tilt value: %d",pan_pos,tilt_pos);
-  	if (VISCA_set_pantilt_home(&x->iface, &x->camera)!=VISCA_SUCCESS)
+  	if (VISCA_set_pantilt_home(&x->conn->iface, &x->conn->cameras[x->address])!=VISCA_SUCCESS)
     	post("error setting pan tilt home\n");
   	else
     	post("Setting pan tilt home\n");
+	pthread_mutex_unlock(&x->conn->iface_lock);
 	outlet_bang(x->bang_out);
 }
 /*-----------------------------------------------------*/
 
 
-void *visca_new(){
-	t_visca *x = (t_visca *)pd_new(visca_class);
+// [visca n] talks to camera n on the chain (default 1)
+static void visca_init(t_visca *x, int argc, t_atom *argv){
 	x->float_out = outlet_new(&x->x_obj, &s_float);
 	x->bang_out = outlet_new(&x->x_obj, &s_bang);	
+	x->data_out = outlet_new(&x->x_obj, &s_anything);
+	x->address = (int)atom_getfloatarg(0, argc, argv);
+	x->deadline = VISCA_INQUIRY_DEADLINE_MS;
+	x->canvas = canvas_getcurrent();
+	x->at_ref = clock_getlogicaltime();
+	x->estimate_poll = 1000;
+	x->fov_rate = 1;
+	if (x->address < 1 || x->address > VISCA_MAX_CAMERAS)
+		x->address = 1;
+	pthread_mutex_init(&x->event_lock, 0);
+	x->poll_clock = clock_new(x, (t_method)visca_poll_tick);
+	x->devices_clock = clock_new(x, (t_method)visca_devices_tick);
+	x->estimate_clock = clock_new(x, (t_method)visca_estimate_tick);
+	// tracking defaults: D30 AT positions, half the link
+	x->track.kp = 1;
+	x->track.ki = 0;
+	x->track.kd = 0.05;
+	x->track.rate = 20;
+	x->track.budget = 0.5;
+	x->track.center_x = 7.5;
+	x->track.center_y = 5.5;
+	x->track.range_x = 7.5;
+	x->track.range_y = 5.5;
+	x->track.deadband = 0.1;
+}
+
+void *visca_new(t_symbol *s, int argc, t_atom *argv){
+	t_visca *x = (t_visca *)pd_new(visca_class);
+	visca_init(x, argc, argv);
+	return (void *) x;
+}
+
+// [visca~ n]: the same, steered by pan, tilt, zoom and focus signals
+void *visca_tilde_new(t_symbol *s, int argc, t_atom *argv){
+	t_visca *x = (t_visca *)pd_new(visca_tilde_class);
+	int ch;
+	for (ch = 1; ch < VISCA_SIG_CHANNELS; ch++)
+		inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+	visca_init(x, argc, argv);
+	x->sig_channels = (1 << VISCA_SIG_CHANNELS) - 1;
+	x->sig_interval = VISCA_SIG_INTERVAL_MS;
+	x->sig_deadband = 0.02;
+	x->sig_clock = clock_new(x, (t_method)visca_tilde_tick);
 	return (void *) x;
 }
 
 void visca_free(t_visca *x){
+	visca_conn_detach(x);
+	clock_free(x->poll_clock);
+	clock_free(x->devices_clock);
+	clock_free(x->estimate_clock);
+	visca_bank_free(x->bank);
+	if (x->sig_clock)
+		clock_free(x->sig_clock);
+	pthread_mutex_destroy(&x->event_lock);
+	outlet_free(x->data_out);
 	outlet_free(x->bang_out);
 	outlet_free(x->float_out);
 }
@@ -436,6 +4937,91 @@ void visca_setup(void){
 		class_addmethod(visca_class, (t_method)visca_sendcom, gensym("send"),A_GIMME, 0);
 		// Test Paning After Connection Open
 		class_addmethod(visca_class, (t_method)visca_pantest, gensym("pan"), 0);
+		// Host Side Auto-Tracking
+		class_addmethod(visca_class, (t_method)visca_track, gensym("track"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_track_gains, gensym("track_gains"), A_FLOAT, A_FLOAT, A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_track_rate, gensym("track_rate"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_track_budget, gensym("track_budget"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_track_frame, gensym("track_frame"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_track_deadband, gensym("track_deadband"), A_FLOAT, 0);
+		// Follow Mode
+		class_addmethod(visca_class, (t_method)visca_follow, gensym("follow"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_follow_mirror, gensym("follow_mirror"), A_FLOAT, 0);
+		// World-Space Look-At
+		class_addmethod(visca_class, (t_method)visca_mount, gensym("mount"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_look_at, gensym("look_at"), A_GIMME, 0);
+		// Pan/Tilt Drive
+		class_addmethod(visca_class, (t_method)visca_drive_method, gensym("drive"), A_FLOAT, A_FLOAT, 0);
+		// Low Latency Mode
+		class_addmethod(visca_class, (t_method)visca_low_latency, gensym("low_latency"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_ack_return, gensym("ack_return"), A_FLOAT, 0);
+		// Queued Commands
+		class_addmethod(visca_class, (t_method)visca_stop, gensym("stop"), 0);
+		class_addmethod(visca_class, (t_method)visca_position, gensym("position"), 0);
+		class_addmethod(visca_class, (t_method)visca_deadline, gensym("deadline"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_weight, gensym("weight"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_stats, gensym("stats"), 0);
+		// Zoom Drive
+		class_addmethod(visca_class, (t_method)visca_zoom_drive, gensym("zoom_drive"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_zoom_value, gensym("zoom_value"), 0);
+		class_addmethod(visca_class, (t_method)visca_zoom_to, gensym("zoom_to"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_focus_track, gensym("focus_track"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_focus_learn, gensym("focus_learn"), 0);
+		class_addmethod(visca_class, (t_method)visca_focus_curve, gensym("focus_curve"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_focus_clear, gensym("focus_clear"), 0);
+		// Position Estimate
+		class_addmethod(visca_class, (t_method)visca_estimate, gensym("estimate"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_estimate_poll, gensym("estimate_poll"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_speed_table, gensym("speed_table"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_drive_fov, gensym("drive_fov"), A_FLOAT, A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_fov_rate, gensym("fov_rate"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_fov_table, gensym("fov_table"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_profile, gensym("profile"), A_SYMBOL, 0);
+		class_addmethod(visca_class, (t_method)visca_moveto, gensym("moveto"), A_GIMME, 0);
+		// Camera Address
+		class_addmethod(visca_class, (t_method)visca_camera, gensym("camera"), A_FLOAT, 0);
+		class_addmethod(visca_class, (t_method)visca_raw, gensym("raw"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_cues, gensym("cues"), A_SYMBOL, 0);
+		class_addmethod(visca_class, (t_method)visca_go, gensym("go"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_at, gensym("at"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_at_clock, gensym("at_clock"), A_GIMME, 0);
+		class_addmethod(visca_class, (t_method)visca_clock, gensym("clock"), 0);
+		class_addmethod(visca_class, (t_method)visca_session_file, gensym("session_file"), A_DEFSYM, 0);
+		class_addmethod(visca_class, (t_method)visca_session_forget, gensym("session_forget"), 0);
+		// Signal Control [visca~] (part of the visca library: load it with [declare -lib visca])
+		visca_tilde_class = class_new(gensym("visca~"), (t_newmethod)visca_tilde_new,
+			(t_method)visca_free, sizeof(t_visca), CLASS_DEFAULT, A_GIMME, 0);
+		CLASS_MAINSIGNALIN(visca_tilde_class, t_visca, sig_f);
+		class_addmethod(visca_tilde_class, (t_method)visca_tilde_dsp, gensym("dsp"), A_CANT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_opencom, gensym("open"), A_GIMME, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_closecom, gensym("close"), 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_camera, gensym("camera"), A_FLOAT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_low_latency, gensym("low_latency"), A_FLOAT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_ack_return, gensym("ack_return"), A_FLOAT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_stop, gensym("stop"), 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_weight, gensym("weight"), A_FLOAT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_tilde_mode, gensym("mode"), A_SYMBOL, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_tilde_channels, gensym("channels"), A_GIMME, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_tilde_interval, gensym("interval"), A_FLOAT, 0);
+		class_addmethod(visca_tilde_class, (t_method)visca_tilde_deadband, gensym("deadband"), A_FLOAT, 0);
+		s_track = gensym("track");
+		s_link = gensym("link");
+		s_latency = gensym("latency");
+		s_error = gensym("error");
+		s_position = gensym("position");
+		s_expired = gensym("expired");
+		s_zoom = gensym("zoom");
+		s_cue = gensym("cue");
+		s_jitter = gensym("jitter");
+		s_raw = gensym("raw");
+		s_completed = gensym("completed");
+		s_done = gensym("done");
+		s_pantilt = gensym("pantilt");
+		s_home = gensym("home");
+		s_reset = gensym("reset");
+		s_preset = gensym("preset");
+		s_focus = gensym("focus");
+		s_focus_point = gensym("focus_point");
 		
 	    verbose(-1, "-----------------------------------\n"
 					"visca - PD external for unix/windows\n"